@@ -0,0 +1,327 @@
+/**
+ * @file lcd_bench.c Bus cost of driver operations.
+ *
+ * Counts the lcdBusIO, lcdDelay and batch handler calls each API makes, with
+ * the simulator behind them answering reads. The numbers only depend on the
+ * driver and busTiming, so they can be compared between revisions.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include "lcd_sim.h"
+#include "lcd_pcf8574.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+/**
+ * Benchmark context, stored in the driver user data.
+ */
+typedef struct {
+    lcdSim_t sim;
+    bool en;                        /** Last enable state. */
+    uint32_t busCalls;              /** lcdBusIO calls. */
+    uint32_t batches;               /** Batch handler calls. */
+    uint32_t edges;                 /** Enable transitions. */
+    uint32_t delayCalls;            /** lcdDelay calls. */
+    uint64_t delayTotal;            /** Microseconds requested from lcdDelay. */
+} bench_t;
+
+static int benchBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    bench_t *bench = driver->userData;
+    bench->busCalls++;
+    if (en != bench->en)
+        bench->edges++;
+    bench->en = en;
+    return lcdSimPins(&bench->sim, rw, rs, en, data);
+}
+
+static int benchBatch(lcdDriver_t *driver, const lcdBusStep_t *steps, size_t count, bool more)
+{
+    // Executed right away, so nothing is held for the closing call.
+    (void)more;
+    bench_t *bench = driver->userData;
+    if (count == 0)
+        return 0;
+    bench->batches++;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (steps[i].en != bench->en)
+            bench->edges++;
+        bench->en = steps[i].en;
+        lcdSimPins(&bench->sim, steps[i].rw, steps[i].rs, steps[i].en, steps[i].data);
+        lcdSimAdvance(&bench->sim, (uint64_t)steps[i].delay * 1000);
+        bench->delayTotal += steps[i].delay;
+    }
+    return 0;
+}
+
+static int benchDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    bench_t *bench = driver->userData;
+    bench->delayCalls++;
+    bench->delayTotal += delay;
+    lcdSimAdvance(&bench->sim, (uint64_t)delay * 1000);
+    return 0;
+}
+
+/**
+ * Print and reset the counters.
+ */
+static void report(bench_t *bench, const char *name)
+{
+    printf("  %-28s %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %10" PRIu64 "\n",
+        name, bench->busCalls, bench->batches, bench->edges, bench->delayCalls, bench->delayTotal);
+    bench->busCalls = 0;
+    bench->batches = 0;
+    bench->edges = 0;
+    bench->delayCalls = 0;
+    bench->delayTotal = 0;
+}
+
+static void drawScreen(lcdDriver_t *lcd, const char *const *screen)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        lcdSetCursor(lcd, 0, row);
+        lcdPutZString(lcd, screen[row]);
+    }
+}
+
+static void bench(bool fourBits, bool writeOnly, bool batched)
+{
+    static const uint8_t glyph[8] = { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 };
+    static const char *const screen[4] = {
+        "Temperature:  21.5 C",
+        "Humidity:     40.0 %",
+        "Pressure:   1013 hPa",
+        "Uptime:     12:34:56",
+    };
+    static const char *const update[4] = {
+        "Temperature:  21.6 C",
+        "Humidity:     40.0 %",
+        "Pressure:   1013 hPa",
+        "Uptime:     12:34:57",
+    };
+
+    bench_t bench;
+    memset(&bench, 0, sizeof(bench));
+    lcdSimInit(&bench.sim, 20, 4, fourBits);
+
+    lcdDriver_t lcd;
+    memset(&lcd, 0, sizeof(lcd));
+    lcd.dimensions.width = 20;
+    lcd.dimensions.height = 4;
+    lcd.fourBits = fourBits;
+    lcd.writeOnly = writeOnly;
+    lcd.userData = &bench;
+    lcd.busIO = benchBusIO;
+    lcd.delay = benchDelay;
+    lcd.batch = batched ? benchBatch : NULL;
+    lcdLoadDefaultTiming(&lcd);
+
+    printf("%s, %s%s:\n", fourBits ? "4-bit" : "8-bit", writeOnly ? "write-only" : "read-write", batched ? ", batched" : "");
+    printf("  %-28s %8s %8s %8s %8s %10s\n", "operation", "bus", "batches", "edges", "delays", "delay us");
+
+    lcdInit(&lcd);
+    report(&bench, "lcdInit");
+    lcdClear(&lcd);
+    report(&bench, "lcdClear");
+    lcdStoreGlyph(&lcd, 0, glyph);
+    report(&bench, "lcdStoreGlyph");
+    lcdSetCursor(&lcd, 5, 1);
+    report(&bench, "lcdSetCursor");
+    lcdPutChar(&lcd, 'x');
+    report(&bench, "lcdPutChar");
+    lcdPutString(&lcd, "0123456789", 10);
+    report(&bench, "lcdPutString (10 chars)");
+
+    drawScreen(&lcd, screen);
+    report(&bench, "full screen redraw");
+
+    lcd.buffered = true;
+    lcdClear(&lcd);
+    drawScreen(&lcd, screen);
+    lcdFlush(&lcd);
+    report(&bench, "buffered full screen draw");
+    lcdClear(&lcd);
+    drawScreen(&lcd, update);
+    lcdFlush(&lcd);
+    report(&bench, "buffered redraw (2 changes)");
+
+    if (bench.sim.violations)
+        printf("  %" PRIu32 " violations, last: %s\n", bench.sim.violations, bench.sim.lastViolation);
+}
+
+/**
+ * I2C bus for the PCF8574 backend, the time is the bytes on the wire plus the delays.
+ */
+typedef struct {
+    lcdSim_t sim;
+    uint32_t byteTime;              /** Nanoseconds per byte on the wire. */
+    uint32_t transactions;          /** I2C transactions. */
+    uint64_t time;                  /** Nanoseconds spent on the bus or waiting. */
+} benchI2C_t;
+
+static int benchI2CWrite(void *bus, uint8_t address, const uint8_t *data, size_t length)
+{
+    (void)address;
+    benchI2C_t *i2c = bus;
+    i2c->transactions++;
+    i2c->time += i2c->byteTime;
+    lcdSimAdvance(&i2c->sim, i2c->byteTime);
+    for (size_t i = 0; i < length; i++)
+    {
+        i2c->time += i2c->byteTime;
+        lcdSimAdvance(&i2c->sim, i2c->byteTime);
+        lcdSimPins(&i2c->sim, data[i] & 0x02, data[i] & 0x01, data[i] & 0x04, data[i] & 0xF0);
+    }
+    return 0;
+}
+
+static int benchI2CDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    lcdPcf8574_t *backpack = driver->userData;
+    benchI2C_t *i2c = backpack->bus;
+    i2c->time += (uint64_t)delay * 1000;
+    lcdSimAdvance(&i2c->sim, (uint64_t)delay * 1000);
+    return 0;
+}
+
+/**
+ * Full 20x4 redraw through a write only PCF8574 backpack at 100 kHz.
+ */
+static void benchPcf8574(bool packed, bool buffered)
+{
+    static const char *const screen[4] = {
+        "Temperature:  21.5 C",
+        "Humidity:     40.0 %",
+        "Pressure:   1013 hPa",
+        "Uptime:     12:34:56",
+    };
+
+    benchI2C_t i2c;
+    memset(&i2c, 0, sizeof(i2c));
+    lcdSimInit(&i2c.sim, 20, 4, true);
+
+    lcdPcf8574_t backpack;
+    lcdPcf8574Init(&backpack, LCD_PCF8574_ADDRESS, 100000, LCD_EXPANDER_BUFFER, benchI2CWrite, NULL, &i2c);
+    i2c.byteTime = backpack.expander.byteTime;
+
+    lcdDriver_t lcd;
+    memset(&lcd, 0, sizeof(lcd));
+    lcd.dimensions.width = 20;
+    lcd.dimensions.height = 4;
+    lcd.fourBits = true;
+    lcd.writeOnly = true;
+    lcd.delay = benchI2CDelay;
+    lcdLoadDefaultTiming(&lcd);
+    lcdPcf8574Attach(&backpack, &lcd);
+    if (!packed)
+        lcd.batch = NULL;
+
+    lcdInit(&lcd);
+    lcd.buffered = buffered;
+    i2c.transactions = 0;
+    i2c.time = 0;
+    drawScreen(&lcd, screen);
+    lcdFlush(&lcd);
+    printf("  %-28s %8" PRIu32 " %8" PRIu64 " ms\n", !packed ? "one write per edge" : buffered ? "packed, lcdFlush" : "packed",
+        i2c.transactions, i2c.time / 1000000);
+
+    if (i2c.sim.violations)
+        printf("  %" PRIu32 " violations, last: %s\n", i2c.sim.violations, i2c.sim.lastViolation);
+}
+
+static pthread_mutex_t benchMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void benchLock(lcdDriver_t *driver)
+{
+    (void)driver;
+    pthread_mutex_lock(&benchMutex);
+}
+
+static void benchUnlock(lcdDriver_t *driver)
+{
+    (void)driver;
+    pthread_mutex_unlock(&benchMutex);
+}
+
+static int nullBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    (void)driver; (void)rw; (void)rs; (void)en; (void)data;
+    return 0;
+}
+
+/**
+ * Only adds up the requested delays, in the driver user data.
+ */
+static int nullDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    *(uint64_t *)driver->userData += delay;
+    return 0;
+}
+
+static uint64_t nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/**
+ * CPU time of lcdSetCursor and lcdPutString with an instant bus, with and
+ * without an uncontended mutex, next to the bus time they request.
+ */
+static void benchLocking(bool locked)
+{
+    enum { rounds = 20000 };
+
+    uint64_t busTime = 0;
+    lcdDriver_t lcd;
+    memset(&lcd, 0, sizeof(lcd));
+    lcd.dimensions.width = 20;
+    lcd.dimensions.height = 4;
+    lcd.fourBits = true;
+    lcd.writeOnly = true;
+    lcd.userData = &busTime;
+    lcd.busIO = nullBusIO;
+    lcd.delay = nullDelay;
+    lcd.lock = locked ? benchLock : NULL;
+    lcd.unlock = locked ? benchUnlock : NULL;
+    lcdLoadDefaultTiming(&lcd);
+    lcdInit(&lcd);
+
+    busTime = 0;
+    uint64_t start = nanoseconds();
+    for (int i = 0; i < rounds; i++)
+    {
+        lcdSetCursor(&lcd, 0, i & 3);
+        lcdPutString(&lcd, "Temperature:  21.5 C", 20);
+    }
+    uint64_t cpu = nanoseconds() - start;
+
+    printf("  %-28s %8" PRIu64 " ns %8" PRIu64 " us\n", locked ? "mutex" : "no lock", cpu / rounds, busTime / rounds);
+}
+
+int main(void)
+{
+    for (int mode = 0; mode < 8; mode++)
+        bench(!(mode & 1), !(mode & 2), mode & 4);
+
+    printf("PCF8574 at 100 kHz, full screen redraw:\n");
+    printf("  %-28s %8s %11s\n", "backend", "writes", "time");
+    benchPcf8574(false, false);
+    benchPcf8574(true, false);
+    benchPcf8574(true, true);
+
+    printf("Locking, lcdSetCursor and a 20 character lcdPutString:\n");
+    printf("  %-28s %11s %11s\n", "lock", "cpu", "bus");
+    benchLocking(false);
+    benchLocking(true);
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 #if defined(__GNUC__) || defined(__clang__)
@@ -70,12 +71,44 @@
  */
 #define LCD_CMD_DADDR(addr)     (0x80 | (addr & 0x7F))
 
+/**
+ * Update the driver statistics, see lcdStats_t. Define as 0 to leave the
+ * counters out of the bus paths.
+ */
+#ifndef LCD_STATS
+#define LCD_STATS 1
+#endif
+
+/**
+ * Number of bus steps collected before they are handed to the batch handler,
+ * see lcdBusBatchHandler_t.
+ */
+#ifndef LCD_BATCH_STEPS
+#define LCD_BATCH_STEPS 48
+#endif
+
+/** Size of the display RAM in bytes. */
+#define LCD_DDRAM_SIZE              80
+/** Number of display RAM bytes per display line. */
+#define LCD_DDRAM_LINE              40
+
 #define LCD_TIMING_ADDRESS_SETUP    10
 #define LCD_TIMING_ENABLE_HOLD      10
 #define LCD_TIMING_DATA_HOLD        10
 #define LCD_TIMING_BUSY_INTERVAL    50
-#define LCD_TIMING_BUSY_HOLD_SHORT  500
-#define LCD_TIMING_BUSY_HOLD_LONG   50000
+#define LCD_TIMING_EXECUTE          37
+#define LCD_TIMING_EXECUTE_LONG     1520
+#define LCD_TIMING_DATA_WRITE       37
+
+/**
+ * Class of a command byte, an index into the command execution time table.
+ * @param cmd The command byte.
+ * @remarks The class is the position of the highest set bit, 0 for LCD_CMD_CLEAR
+ * up to 7 for LCD_CMD_DADDR.
+ */
+#define LCD_CMD_CLASS(cmd)\
+    (((cmd) & 0x80) ? 7 : ((cmd) & 0x40) ? 6 : ((cmd) & 0x20) ? 5 : ((cmd) & 0x10) ? 4 : \
+     ((cmd) & 0x08) ? 3 : ((cmd) & 0x04) ? 2 : ((cmd) & 0x02) ? 1 : 0)
 
 /**
  * Driver structure.
@@ -111,6 +144,91 @@ typedef int (*lcdBusIOHandler_t)(lcdDriver_t* driver, bool rw, bool rs, bool en,
  */
 typedef int (*lcdDelayHandler_t)(lcdDriver_t* driver, uint32_t delay);
 
+/**
+ * Read a monotonic clock.
+ * @param driver The driver structure calling, for convenience.
+ * @return Current time in microseconds.
+ * @remarks
+ * Optional. When set, the driver notes when each bus phase started and only
+ * calls lcdDelay for the part of a delay that has not already passed by the
+ * next bus access, so slow buses and the caller's own work between calls
+ * count towards the bus timing.
+ */
+typedef uint64_t (*lcdClockHandler_t)(lcdDriver_t* driver);
+
+/**
+ * Take or release the driver lock.
+ * @param driver The driver structure calling, for convenience.
+ * @remarks
+ * Optional, set both to share a driver between tasks. The lock is held for
+ * each logical operation, such as lcdPutString or lcdFlush, and must allow
+ * the holder to take it again (a recursive mutex) if lcdLock is used around
+ * several of them. Primitives such as lcdCommand and lcdWrite do not lock.
+ */
+typedef void (*lcdLockHandler_t)(lcdDriver_t* driver);
+
+/**
+ * A single bus step: set the pins, then wait.
+ */
+typedef struct lcdBusStep_t
+{
+    bool rw:1;                      /** Read/Write pin state, always false. */
+    bool rs:1;                      /** Register select pin state. */
+    bool en:1;                      /** Enable pin state. */
+    uint8_t padding:5;              /** Padding for flags */
+    uint8_t data;                   /** Data bus output. */
+    uint32_t delay;                 /** Time to wait after setting the pins, in microseconds. */
+} lcdBusStep_t;
+
+/**
+ * Execute a sequence of bus steps.
+ * @param driver The driver structure calling, for convenience.
+ * @param steps The steps, in order.
+ * @param count Number of steps.
+ * @param more More steps follow right after these.
+ * @return Non-negative if successful, negative on error.
+ * @remarks
+ * Optional. When set, writes are handed over as whole sequences, in parts of
+ * at most LCD_BATCH_STEPS, instead of one lcdBusIO and lcdDelay call per edge.
+ * While more is set the handler may hold the steps back, to send them along
+ * with the following ones in as few transfers as the bus allows. Otherwise
+ * all steps, held ones included, must have been executed when it returns, or
+ * be queued to execute ahead of any later bus access. A call without steps
+ * only sends what is held. Reads and the initialization
+ * sequence still go through lcdBusIO and lcdDelay, after held steps are sent.
+ */
+typedef int (*lcdBusBatchHandler_t)(lcdDriver_t* driver, const lcdBusStep_t *steps, size_t count, bool more);
+
+/** Returned by int64_t lcdPoll(lcdDriver_t*,uint64_t) when no step is queued. */
+#define LCD_POLL_IDLE INT64_MAX
+
+/**
+ * Display RAM layouts of the modules.
+ */
+typedef enum lcdGeometry_t
+{
+    LCD_GEOMETRY_STANDARD = 0,      /** Rows at 0x00, 0x40, width and 0x40 + width. */
+    LCD_GEOMETRY_SPLIT,             /** Single row whose right half is on the second line, such as 16x1 modules at 0x00-0x07 and 0x40-0x47. */
+    LCD_GEOMETRY_WIDE,              /** Rows at 0x00, 0x40, 0x14 and 0x54, such as 16x4 modules using a 20x4 layout. */
+    LCD_GEOMETRY_CUSTOM,            /** Layout set in the driver structure. */
+} lcdGeometry_t;
+
+/**
+ * Driver statistics.
+ */
+typedef struct lcdStats_t
+{
+    uint32_t commands;              /** Commands issued. */
+    uint32_t writes;                /** Data bytes written. */
+    uint32_t reads;                 /** Data bytes read. */
+    uint32_t busyPolls;             /** Busy flag reads. */
+    uint32_t delays;                /** Delays requested. */
+    uint32_t errors;                /** Failed calls. */
+    uint64_t delayTotal;            /** Total delay requested in microseconds. */
+    uint64_t delaySlept;            /** With a clock, total delay that had not passed and was slept, in microseconds. */
+    uint64_t maxLatency;            /** Longest single command, write or read call in microseconds, on the clock if set, else the delay it requested. */
+} lcdStats_t;
+
 /**
  * The LCD driver structure.'
  */
@@ -121,31 +239,62 @@ struct lcdDriver_t
         uint8_t width;              /** Width of display. */
         uint8_t height;             /** Height of display. */
     } dimensions;                   /** Display dimensions. */
+    lcdGeometry_t geometry;         /** Display RAM layout of the module. */
+    struct {
+        uint8_t rowBase[4];         /** Display RAM address of the first column of each row. */
+        uint8_t split;              /** First column continuing on the second line, width for none. */
+    } layout;                       /** Filled by int lcdInit(lcdDriver_t*) unless geometry is LCD_GEOMETRY_CUSTOM. */
     bool fourBits:1;                /** Operate display in 4-bit mode. */
     bool writeOnly:1;               /** Write only mode of operation. */
     bool largeFont:1;               /** Use large font (5x10). */
-    uint8_t padding0:5;             /** Padding for flags */
+    bool buffered:1;                /** Write text into the shadow display RAM, see int lcdFlush(lcdDriver_t*). May be toggled at any time. */
+    uint8_t padding0:4;             /** Padding for flags */
     void *userData;                 /** Storage for your usage */
     lcdBusIOHandler_t busIO;        /** LCD IO function handler, if not strongly linked. */
     lcdDelayHandler_t delay;        /** Delay function used to ensure bus timing, if not strongly linked. */
+    lcdBusBatchHandler_t batch;     /** Optional handler for whole sequences of bus steps. */
+    lcdClockHandler_t now;          /** Optional clock, to skip delays that have already passed. */
+    lcdLockHandler_t lock;          /** Optional lock, see lcdLockHandler_t. */
+    lcdLockHandler_t unlock;        /** Optional unlock, see lcdLockHandler_t. */
+    lcdBusStep_t *queue;            /** Optional step storage for non-blocking mode, see int64_t lcdPoll(lcdDriver_t*,uint64_t). */
+    uint16_t queueSize;             /** Number of steps in queue. */
 
 
     struct {
         uint32_t addressSetup;      /** Time to wait after setting up address lines. */
         uint32_t enableHold;        /** Time to wait after setting enable high. */
         uint32_t dataHold;          /** Time to wait after setting enable low. */
-        uint32_t busyInterval;      /** (read-write mode) Busy flag check interval. */
-        uint32_t busyHoldShort;     /** (write-only mode) Hold time after write, short version. */
-        uint32_t busyHoldLong;      /** (write-only mode) Hold time after write, long version.  */
+        uint32_t busyInterval;      /** (read-write mode) Delay between busy flag checks while the LCD is busy. */
+        uint32_t execute[8];        /** (write-only mode) Hold time after each command, indexed by LCD_CMD_CLASS(cmd). */
+        uint32_t dataWrite;         /** Hold time after a data write, and between bytes of a burst. */
     } busTiming;                    /** Bus timing variables. Great for tuning for specific displays. See void lcdLoadDefaultTiming(lcdDriver_t*). */
 
+    lcdStats_t stats;               /** Driver statistics, see void lcdGetStats(lcdDriver_t*,lcdStats_t*). */
+
     /* private to implementation, modify at your own risk. */
     struct {
         int8_t x;
         int8_t y;
     } cursor;
     bool direction:1;
-    uint8_t padding1:7;
+    bool addressValid:1;            /** The address counter of the LCD is known and points into display RAM. */
+    bool twoLines:1;                /** The layout uses the second line, the LCD runs in two line mode. */
+    bool batchOpen:1;               /** The current operation goes on after its next wait, see lcdBusBatchHandler_t. */
+    bool batchHeld:1;               /** The batch handler may be holding steps back. */
+    uint8_t padding1:3;
+    uint8_t address;                /** Address counter of the LCD, if known. */
+    uint64_t deadline;              /** With a clock, time the next bus access has to wait for. */
+    struct {
+        uint16_t head;              /** Oldest queued step. */
+        uint16_t count;             /** Number of queued steps. */
+        bool known;                 /** The time the last step is due is known. */
+        uint32_t hold;              /** Delay after the last executed step. */
+        uint64_t due;               /** Time the next step is due, in microseconds. */
+    } poll;
+    struct {
+        uint8_t ram[LCD_DDRAM_SIZE];            /** Display RAM contents as the application wants them. */
+        uint8_t shown[LCD_DDRAM_SIZE];          /** Display RAM contents as last sent to the LCD. */
+    } shadow;
 };
 
 /**
@@ -174,6 +323,46 @@ int WEAK lcdBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data);
  */
 int WEAK lcdDelay(lcdDriver_t *driver, uint32_t delay);
 
+/**
+ * Execute the queued bus steps that are due.
+ * @param driver The driver structure, with a queue.
+ * @param now Current time in microseconds, from a monotonic clock, the one
+ * of lcdDriver_t.now if set.
+ * @return Time the next step is due in microseconds, LCD_POLL_IDLE if the
+ * queue is empty, negative on error. Updates errno.
+ * @remarks In non-blocking mode, writes and commands only queue their bus
+ * steps and return; call this from a main loop or timer until it returns
+ * LCD_POLL_IDLE. Needs a write only driver. When the queue is full, a call
+ * executes steps itself, waiting with lcdDelay, until there is room. The
+ * reset sequence of lcdInit always blocks.
+ */
+int64_t lcdPoll(lcdDriver_t *driver, uint64_t now);
+
+/**
+ * Time the next queued bus step is due.
+ * @param driver The driver structure, with a queue.
+ * @param now Current time in microseconds.
+ * @return Time in microseconds, LCD_POLL_IDLE if the queue is empty.
+ * @remarks For schedulers sharing a bus between drivers, see lcd_multi.h.
+ */
+int64_t lcdPollNext(lcdDriver_t *driver, uint64_t now);
+
+/**
+ * Execute the next queued bus step, whether it is due or not.
+ * @param driver The driver structure, with a non-empty queue.
+ * @param now Current time in microseconds.
+ * @param step Where to copy the executed step, may be NULL.
+ * @return Non-zero value on error. Updates errno.
+ */
+int lcdPollStep(lcdDriver_t *driver, uint64_t now, lcdBusStep_t *step);
+
+/**
+ * Execute all queued bus steps, waiting with lcdDelay.
+ * @param driver The driver structure, with a queue.
+ * @return Non-zero value on error. Updates errno.
+ */
+int lcdSync(lcdDriver_t *driver);
+
 /**
  * Load default bus timings into the driver structure.
  * @param driver The driver structure.
@@ -185,14 +374,43 @@ inline static void lcdLoadDefaultTiming(lcdDriver_t *driver)
     driver->busTiming.enableHold    = LCD_TIMING_ENABLE_HOLD;
     driver->busTiming.dataHold      = LCD_TIMING_DATA_HOLD;
     driver->busTiming.busyInterval  = LCD_TIMING_BUSY_INTERVAL;
-    driver->busTiming.busyHoldShort = LCD_TIMING_BUSY_HOLD_SHORT;
-    driver->busTiming.busyHoldLong  = LCD_TIMING_BUSY_HOLD_LONG;
+    driver->busTiming.dataWrite     = LCD_TIMING_DATA_WRITE;
+
+    for (int i = 0; i < 8; i++)
+        driver->busTiming.execute[i] = LCD_TIMING_EXECUTE;
+    driver->busTiming.execute[LCD_CMD_CLASS(LCD_CMD_CLEAR())] = LCD_TIMING_EXECUTE_LONG;
+    driver->busTiming.execute[LCD_CMD_CLASS(LCD_CMD_HOME())]  = LCD_TIMING_EXECUTE_LONG;
+}
+
+/**
+ * Get the driver statistics.
+ * @param driver The driver structure.
+ * @param stats Storage for the statistics.
+ * @remarks The counters are only updated when LCD_STATS is non-zero.
+ */
+inline static void lcdGetStats(lcdDriver_t *driver, lcdStats_t *stats)
+{
+    assert(driver);
+    assert(stats);
+    *stats = driver->stats;
+}
+
+/**
+ * Reset the driver statistics.
+ * @param driver The driver structure.
+ */
+inline static void lcdResetStats(lcdDriver_t *driver)
+{
+    assert(driver);
+    memset(&driver->stats, 0, sizeof(driver->stats));
 }
 
 /**
  * Initialize the LCD display.
  * @param driver The driver structure.
  * @return Non-zero if unsuccessful.
+ * @remarks Fills the layout from the geometry, and puts the LCD in two line
+ * mode if the layout uses the second line.
  */
 int lcdInit(lcdDriver_t *driver);
 
@@ -204,6 +422,16 @@ int lcdInit(lcdDriver_t *driver);
  */
 int lcdCommand(lcdDriver_t *driver, uint8_t command);
 
+/**
+ * Read the busy flag and address counter of the LCD.
+ * @param driver The driver structure.
+ * @return The busy flag in bit 7 and the address counter in bits 0-6,
+ * negative if unsuccessful.
+ * @remarks Only available in read-write mode. The address counter may still
+ * change for a few microseconds after the busy flag clears.
+ */
+int lcdReadStatus(lcdDriver_t *driver);
+
 /**
  * Write data to display or character RAM.
  * @param driver The driver sturcure.
@@ -212,6 +440,55 @@ int lcdCommand(lcdDriver_t *driver, uint8_t command);
  */
 int lcdWrite(lcdDriver_t *driver, uint8_t data);
 
+/**
+ * Write a sequence of bytes to display or character RAM.
+ * @param driver The driver structure.
+ * @param data Data to write.
+ * @param length Number of bytes to write.
+ * @return Non-zero if unsuccessful.
+ * @remarks Faster than calling int lcdWrite(lcdDriver_t*,uint8_t) for each byte,
+ * the bytes are spaced by the data write time and the LCD is only waited
+ * for once, after the last byte.
+ */
+int lcdWriteBuffer(lcdDriver_t *driver, const uint8_t *data, size_t length);
+
+/**
+ * Read data from display or character RAM.
+ * @param driver The driver structure.
+ * @param data Storage for the byte read.
+ * @return Non-zero if unsuccessful.
+ * @remarks Only available in read-write mode. Reads from the address counter,
+ * which must be set with LCD_CMD_DADDR or LCD_CMD_CADDR after any write for the
+ * data to be valid.
+ */
+int lcdRead(lcdDriver_t *driver, uint8_t *data);
+
+/**
+ * Read a sequence of bytes from display or character RAM.
+ * @param driver The driver structure.
+ * @param data Storage for the bytes read.
+ * @param length Number of bytes to read.
+ * @return Non-zero if unsuccessful.
+ * @remarks Only available in read-write mode. The bytes are spaced by the data
+ * write time and the LCD is only waited for once, after the last byte.
+ * @see lcdRead
+ */
+int lcdReadBuffer(lcdDriver_t *driver, uint8_t *data, size_t length);
+
+/**
+ * Decode a position on the display.
+ * @param driver The driver structure.
+ * @param x Column.
+ * @param y Row.
+ * @return The display RAM address of the position.
+ * @remarks A row base lookup plus a compare against the split column, which
+ * only modules with a split ever pass.
+ */
+#define LCD_DECODE_POSITION(driver, x, y)\
+    ((driver)->layout.rowBase[y] + (x) +                                    /* Row base from the layout */\
+        (((x) >= (driver)->layout.split) ? 0x40 - (driver)->layout.split : 0) /* Past the split, continue on the second line */\
+    )
+
 /**
  * Decode the cursor position in the driver.
  * @param driver The driver structure.
@@ -219,13 +496,18 @@ int lcdWrite(lcdDriver_t *driver, uint8_t data);
  * @remarks This macro is private to the driver. You should not need
  * to use this.
  */
-#define LCD_DECODE_CURSOR(driver)\
-    ((driver)->cursor.x +                                                   /* Base position */\
-        ( \
-            64 * ((driver)->cursor.y % 2) +                         /* Add 64 if the row is even */\
-            (driver)->dimensions.width * ((driver)->cursor.y >= 2)  /* Add width if the row is the last two. */\
-        ) \
-    )
+#define LCD_DECODE_CURSOR(driver) LCD_DECODE_POSITION(driver, (driver)->cursor.x, (driver)->cursor.y)
+
+/**
+ * Decode a display RAM address into an index into the shadow display RAM.
+ * @param address The display RAM address.
+ * @return The index into lcdDriver_t.shadow.ram.
+ * @remarks This macro is private to the driver. You should not need
+ * to use this.
+ */
+#define LCD_DDRAM_INDEX(address)\
+    ((((address) & 0x40) ? LCD_DDRAM_LINE : 0) + ((address) & 0x3F))
+
 // #include <stdio.h>
 // inline static uint8_t _LCD_DECODE_CURSOR(lcdDriver_t* driver) {
 //     uint8_t value = LCD_DECODE_CURSOR(driver);
@@ -235,6 +517,27 @@ int lcdWrite(lcdDriver_t *driver, uint8_t data);
 // #undef LCD_DECODE_CURSOR
 // #define LCD_DECODE_CURSOR(driver) _LCD_DECODE_CURSOR(driver)
 
+/**
+ * Take the driver lock, if there is one.
+ * @param driver The driver structure.
+ * @remarks Use around sequences of primitives, or to keep several operations together.
+ */
+inline static void lcdLock(lcdDriver_t *driver)
+{
+    if (driver->lock)
+        driver->lock(driver);
+}
+
+/**
+ * Release the driver lock, if there is one.
+ * @param driver The driver structure.
+ */
+inline static void lcdUnlock(lcdDriver_t *driver)
+{
+    if (driver->unlock)
+        driver->unlock(driver);
+}
+
 /**
  * Update the LCD cursor in the driver.
  * @param driver The driver structure.
@@ -267,24 +570,85 @@ inline static void lcdUpdateCursor(lcdDriver_t *driver)
     }
 }
 
+/**
+ * Point the LCD address counter to a display RAM address.
+ * @param driver The driver structure.
+ * @param address The display RAM address.
+ * @return Non-zero value on error. Updates errno.
+ * @remarks This is private to the driver implementation. You should not need to call
+ * this function on your own. The address is only sent if the LCD address counter
+ * is not already there.
+ */
+inline static int lcdSeek(lcdDriver_t *driver, uint8_t address)
+{
+    if (driver->addressValid && driver->address == address)
+        return 0;
+
+    return lcdCommand(driver, LCD_CMD_DADDR(address));
+}
+
+/**
+ * Put a character into the shadow display RAM and advance the cursor.
+ * @param driver The driver structure.
+ * @param chr The character to put.
+ * @remarks This is private to the driver implementation. You should not need to call
+ * this function on your own.
+ */
+inline static void lcdShadowPut(lcdDriver_t *driver, char chr)
+{
+    driver->shadow.ram[LCD_DDRAM_INDEX(LCD_DECODE_CURSOR(driver))] = chr;
+    lcdUpdateCursor(driver);
+}
+
+/**
+ * Send the changed parts of the shadow display RAM to the LCD.
+ * @param driver The driver structure.
+ * @return Non-zero value on error. Updates errno.
+ * @remarks Only does work when the driver is buffered. Cells which were
+ * written with the value they already hold are not sent again.
+ */
+int lcdFlush(lcdDriver_t *driver);
+
+/**
+ * Load the shadow display RAM from the LCD.
+ * @param driver The driver structure.
+ * @return Non-zero value on error. Updates errno.
+ * @remarks Only available in read-write mode. Useful to pick up the display
+ * contents after a warm reset, afterwards only cells written with a different
+ * value are sent by int lcdFlush(lcdDriver_t*).
+ */
+int lcdShadowRead(lcdDriver_t *driver);
+
 /**
  * Clear the LCD.
  * @param driver The driver structure.
  * @return Non-zero value on error. Updates errno.
+ * @remarks When buffered, only the shadow display RAM is cleared, and the
+ * cells that change are sent with the next int lcdFlush(lcdDriver_t*).
  */
 inline static int lcdClear(lcdDriver_t *driver)
 {
     assert(driver);
-    if (lcdCommand(driver, LCD_CMD_CLEAR()) || lcdDelay(driver, driver->busTiming.busyHoldShort))
+    int result = 0;
+    lcdLock(driver);
+    if (driver->buffered)
+    {
+        driver->cursor.x = 0;
+        driver->cursor.y = 0;
+        for (int i = 0; i < driver->dimensions.width * driver->dimensions.height; i++)
+            lcdShadowPut(driver, ' ');
+    }
+    else if (lcdCommand(driver, LCD_CMD_CLEAR()))
     {
-        return -1;
+        result = -1;
     }
     else
     {
         driver->cursor.x = 0;
         driver->cursor.y = 0;
-        return 0;
     }
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -295,16 +659,19 @@ inline static int lcdClear(lcdDriver_t *driver)
 inline static int lcdHome(lcdDriver_t *driver)
 {
     assert(driver);
-    if (lcdCommand(driver, LCD_CMD_HOME()) || lcdDelay(driver, driver->busTiming.busyHoldLong))
+    int result = 0;
+    lcdLock(driver);
+    if (lcdCommand(driver, LCD_CMD_HOME()))
     {
-        return -1;
+        result = -1;
     }
     else
     {
         driver->cursor.x = 0;
         driver->cursor.y = 0;
-        return 0;
     }
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -316,15 +683,14 @@ inline static int lcdHome(lcdDriver_t *driver)
 inline static int lcdDirection(lcdDriver_t *driver, bool forward)
 {
     assert(driver);
-    if (lcdCommand(driver, LCD_CMD_ENTRY(forward, 0)) || lcdDelay(driver, driver->busTiming.busyHoldShort))
-    {
-        return -1;
-    }
+    int result = 0;
+    lcdLock(driver);
+    if (lcdCommand(driver, LCD_CMD_ENTRY(forward, 0)))
+        result = -1;
     else
-    {
         driver->direction = forward;
-        return 0;
-    }
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -335,15 +701,13 @@ inline static int lcdDirection(lcdDriver_t *driver, bool forward)
 inline static int lcdNext(lcdDriver_t *driver)
 {
     assert(driver);
+    int result = 0;
+    lcdLock(driver);
     lcdUpdateCursor(driver);
-    if (lcdCommand(driver, LCD_CMD_DADDR(LCD_DECODE_CURSOR(driver))))
-    {
-        return -1;
-    }
-    else
-    {
-        return 0;
-    }
+    if (!driver->buffered)
+        result = lcdSeek(driver, LCD_DECODE_CURSOR(driver)) ? -1 : 0;
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -357,7 +721,10 @@ inline static int lcdNext(lcdDriver_t *driver)
 inline static int lcdSetDisplay(lcdDriver_t *driver, bool display, bool cursor, bool blink)
 {
     assert(driver);
-    return lcdCommand(driver, LCD_CMD_DISPLAY(display, cursor, blink));
+    lcdLock(driver);
+    int result = lcdCommand(driver, LCD_CMD_DISPLAY(display, cursor, blink));
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -366,6 +733,7 @@ inline static int lcdSetDisplay(lcdDriver_t *driver, bool display, bool cursor,
  * @param column The LCD column.
  * @param row The LCD row.
  * @return Non-zero value on error. Updates errno.
+ * @remarks When buffered, only the position in the driver is changed.
  */
 inline static int lcdSetCursor(lcdDriver_t *driver, uint8_t column, uint8_t row)
 {
@@ -373,11 +741,14 @@ inline static int lcdSetCursor(lcdDriver_t *driver, uint8_t column, uint8_t row)
     assert(driver->dimensions.width > column);
     assert(driver->dimensions.height > row);
 
+    int result = 0;
+    lcdLock(driver);
     driver->cursor.x = column;
     driver->cursor.y = row;
-
-    uint8_t address = LCD_DECODE_CURSOR(driver);
-    return lcdCommand(driver, LCD_CMD_DADDR(address));
+    if (!driver->buffered)
+        result = lcdSeek(driver, LCD_DECODE_CURSOR(driver));
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -397,15 +768,10 @@ inline static int lcdStoreGlyph(lcdDriver_t *driver, char which, const uint8_t *
     assert(bits);
 
     uint8_t address = (driver->largeFont ? which & 0x06 : which) << 3;
-    if (lcdCommand(driver, LCD_CMD_CADDR(address)))
-        return -1;
-
-    for (int i = 0; i < (driver->largeFont ? 10 : 8); i++)
-    {
-        if (lcdWrite(driver, bits[i])) return -1;
-    }
-
-    return 0;
+    lcdLock(driver);
+    int result = (lcdCommand(driver, LCD_CMD_CADDR(address)) || lcdWriteBuffer(driver, bits, driver->largeFont ? 10 : 8)) ? -1 : 0;
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -413,18 +779,23 @@ inline static int lcdStoreGlyph(lcdDriver_t *driver, char which, const uint8_t *
  * @param driver The driver structure.
  * @param chr The character to put.
  * @return Non-zero value on error. Updates errno.
+ * @remarks When buffered, the character is only put into the shadow display RAM.
  * @see lcdPutString
  * @see lcdPutZString
  */
 inline static int lcdPutChar(lcdDriver_t *driver, char chr)
 {
     assert(driver);
-    if (lcdCommand(driver, LCD_CMD_DADDR(LCD_DECODE_CURSOR(driver))) || lcdWrite(driver, chr))
-        return -1;
-
-    lcdUpdateCursor(driver);
-
-    return lcdCommand(driver, LCD_CMD_DADDR(LCD_DECODE_CURSOR(driver)));
+    int result = 0;
+    lcdLock(driver);
+    if (driver->buffered)
+        lcdShadowPut(driver, chr);
+    else if (lcdSeek(driver, LCD_DECODE_CURSOR(driver)) || lcdWrite(driver, chr))
+        result = -1;
+    else
+        lcdUpdateCursor(driver);
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -433,6 +804,7 @@ inline static int lcdPutChar(lcdDriver_t *driver, char chr)
  * @param str The string.
  * @param length Length of the string.
  * @return Non-zero value on error. Updates errno.
+ * @remarks When buffered, the string is only put into the shadow display RAM.
  * @see lcdPutZString @see lcdPutChar
  */
 inline static int lcdPutString(lcdDriver_t *driver, const char *str, size_t length)
@@ -440,26 +812,41 @@ inline static int lcdPutString(lcdDriver_t *driver, const char *str, size_t leng
     assert(driver);
     assert(str);
 
-    uint8_t address = LCD_DECODE_CURSOR(driver);
-    if (lcdCommand(driver, LCD_CMD_DADDR(address))) return -1;
-
-    for (int i = 0; i < length; i++)
+    int result = 0;
+    lcdLock(driver);
+    if (driver->buffered)
     {
-        if (lcdWrite(driver, str[i])) return -1;
-
-        lcdUpdateCursor(driver);
-
+        for (size_t i = 0; i < length; i++)
+            lcdShadowPut(driver, str[i]);
+    }
+    else
+    {
+        size_t i = 0;
+        while (i < length)
         {
-            uint8_t newaddr = LCD_DECODE_CURSOR(driver);
-            if (newaddr != address + 1)
+            // The address counter follows the cursor until it wraps to another row
+            // or reaches the split.
+            size_t run = driver->direction ? driver->dimensions.width - driver->cursor.x : driver->cursor.x + 1;
+            if (driver->direction && driver->cursor.x < driver->layout.split)
+                run = driver->layout.split - driver->cursor.x;
+            else if (!driver->direction && driver->cursor.x >= driver->layout.split)
+                run = driver->cursor.x - driver->layout.split + 1;
+            if (run > length - i)
+                run = length - i;
+
+            if (lcdSeek(driver, LCD_DECODE_CURSOR(driver)) || lcdWriteBuffer(driver, (const uint8_t *)str + i, run))
             {
-                if (lcdCommand(driver, LCD_CMD_DADDR(address))) return -1;
+                result = -1;
+                break;
             }
-            address = newaddr;
+
+            for (size_t j = 0; j < run; j++)
+                lcdUpdateCursor(driver);
+            i += run;
         }
     }
-
-    return lcdCommand(driver, LCD_CMD_DADDR(address));
+    lcdUnlock(driver);
+    return result;
 }
 
 /**
@@ -472,6 +859,4 @@ inline static int lcdPutString(lcdDriver_t *driver, const char *str, size_t leng
  */
 #define lcdPutZString(driver, str) lcdPutString(driver, str, strlen(str))
 
-// int lcdRead(lcdDriver_t *driver, uint8_t *data); // Not implemented.
-
 #endif
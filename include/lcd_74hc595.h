@@ -0,0 +1,56 @@
+#ifndef _LCD_74HC595_H_
+#define _LCD_74HC595_H_
+
+/**
+ * @file lcd_74hc595.h 74HC595 shift register backend.
+ *
+ * Three wire shift register wiring: SPI data and clock into the register and
+ * a latch after every byte. The common wiring is Q1=RS, Q2=EN, Q3-Q6=D4-D7,
+ * Q7=backlight with R/W tied low, so the driver must be write only. A run of
+ * characters becomes one contiguous buffer of latched output states, ready
+ * for a single DMA transfer.
+ */
+
+#include "lcd_expander.h"
+
+/** Pin map of the common wiring, Q0 is unused and stands in for R/W. */
+#define LCD_74HC595_PINS { .rs = 1, .rw = 0, .en = 2, .backlight = 7, .data = { 3, 4, 5, 6 } }
+
+/**
+ * SPI write function. The transport must latch the register after every byte,
+ * for example with the latch on a chip select that toggles per byte.
+ * @param bus Bus handle given to lcd74hc595Init.
+ * @param data The bytes.
+ * @param length Number of bytes.
+ * @return Non-negative if successful, negative on error.
+ */
+typedef int (*lcdSpiWriteHandler_t)(void *bus, const uint8_t *data, size_t length);
+
+/**
+ * The shift register structure.
+ */
+typedef struct lcd74hc595_t
+{
+    lcdExpander_t expander;         /** The port, must be the first member. */
+    lcdSpiWriteHandler_t write;     /** SPI write function. */
+    void *bus;                      /** SPI bus handle. */
+} lcd74hc595_t;
+
+/**
+ * Initialize a shift register structure with the common pin map.
+ * @param shifter The shift register structure.
+ * @param clock SPI clock in Hz.
+ * @param maxLength Most bytes the SPI driver accepts in one transfer, at most LCD_EXPANDER_BUFFER.
+ * @param write SPI write function.
+ * @param bus SPI bus handle.
+ */
+void lcd74hc595Init(lcd74hc595_t *shifter, uint32_t clock, uint16_t maxLength, lcdSpiWriteHandler_t write, void *bus);
+
+/**
+ * Attach a shift register to a driver, replacing its user data, bus IO and batch handlers.
+ * @param shifter The shift register structure.
+ * @param driver The driver, which must be write only and in 4-bit mode.
+ */
+void lcd74hc595Attach(lcd74hc595_t *shifter, lcdDriver_t *driver);
+
+#endif
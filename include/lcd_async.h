@@ -0,0 +1,122 @@
+#ifndef _LCD_ASYNC_H_
+#define _LCD_ASYNC_H_
+
+/**
+ * @file lcd_async.h Background display task.
+ *
+ * Producers on any thread or core push commands and text into a bounded
+ * lock-free ring and return at once. A display task owns the driver and
+ * drains the ring through lcdCommand and lcdWriteBuffer. The task is a
+ * FreeRTOS task under ESP-IDF and a POSIX thread elsewhere.
+ */
+
+#include "lcd.h"
+
+#include <stdatomic.h>
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#else
+#include <pthread.h>
+#include <semaphore.h>
+#endif
+
+/** Stack size of the display task, in bytes. */
+#ifndef LCD_ASYNC_STACK
+#define LCD_ASYNC_STACK 2048
+#endif
+
+/** Priority of the display task. */
+#ifndef LCD_ASYNC_PRIORITY
+#define LCD_ASYNC_PRIORITY 5
+#endif
+
+/** Operation flag for data bytes, commands have it clear. */
+#define LCD_ASYNC_DATA 0x100
+
+/**
+ * Ring slot.
+ */
+typedef struct lcdAsyncSlot_t
+{
+    atomic_uint_least32_t sequence; /** Ring position the slot was last written for, plus one. */
+    uint16_t op;                    /** Command, or data byte with LCD_ASYNC_DATA. */
+} lcdAsyncSlot_t;
+
+/**
+ * The display task structure.
+ */
+typedef struct lcdAsync_t
+{
+    lcdDriver_t *driver;            /** The driver, only used by the display task once started. */
+    lcdAsyncSlot_t *slots;          /** Ring storage. */
+    uint32_t size;                  /** Number of slots, a power of two. */
+    atomic_uint_least32_t errors;   /** Operations the driver failed. */
+
+    /* private to implementation, modify at your own risk. */
+    atomic_uint_least32_t head;     /** Next position the task reads. */
+    atomic_uint_least32_t tail;     /** Next position a producer reserves. */
+    atomic_bool running;
+#ifdef ESP_PLATFORM
+    TaskHandle_t task;
+    SemaphoreHandle_t done;
+    StaticSemaphore_t doneBuffer;
+#else
+    pthread_t thread;
+    sem_t wake;
+#endif
+} lcdAsync_t;
+
+/**
+ * Start a display task.
+ * @param async The display task structure.
+ * @param driver An initialized driver, not to be used by anything else until stopped.
+ * @param slots Ring storage.
+ * @param size Number of slots, a power of two.
+ * @return Non-zero value on error.
+ */
+int lcdAsyncStart(lcdAsync_t *async, lcdDriver_t *driver, lcdAsyncSlot_t *slots, uint32_t size);
+
+/**
+ * Stop a display task once it has executed everything pushed so far.
+ * @param async The display task structure.
+ * @return Non-zero value on error.
+ */
+int lcdAsyncStop(lcdAsync_t *async);
+
+/**
+ * Push operations, kept together in the ring.
+ * @param async The display task structure.
+ * @param ops Commands, and data bytes with LCD_ASYNC_DATA.
+ * @param count Number of operations.
+ * @return Non-zero value if the ring does not have room, nothing is pushed then.
+ * @remarks Lock-free and safe from any number of threads.
+ */
+int lcdAsyncPush(lcdAsync_t *async, const uint16_t *ops, size_t count);
+
+/**
+ * Push a command.
+ * @param async The display task structure.
+ * @param command The command byte, see LCD_CMD_*.
+ * @return Non-zero value if the ring is full.
+ */
+inline static int lcdAsyncCommand(lcdAsync_t *async, uint8_t command)
+{
+    uint16_t op = command;
+    return lcdAsyncPush(async, &op, 1);
+}
+
+/**
+ * Push a string at a position, continuing on the next rows.
+ * @param async The display task structure.
+ * @param x Column.
+ * @param y Row.
+ * @param str The string.
+ * @param length Length of the string.
+ * @return Non-zero value if the ring does not have room, nothing is pushed then.
+ */
+int lcdAsyncPutString(lcdAsync_t *async, int8_t x, int8_t y, const char *str, size_t length);
+
+#endif
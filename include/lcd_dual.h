@@ -0,0 +1,98 @@
+#ifndef _LCD_DUAL_H_
+#define _LCD_DUAL_H_
+
+/**
+ * @file lcd_dual.h Displays with two controllers, such as 40x4 modules.
+ *
+ * Each controller drives two rows and has its own enable line, the other
+ * lines are shared. The text goes into the shadow display RAM of the half the
+ * row belongs to, and lcdDualFlush sends both halves interleaved, so one
+ * controller executes while the other is being written.
+ */
+
+#include "lcd_multi.h"
+
+/** Queued bus steps per half while flushing, enough for a full 4-bit rewrite of a 40x2 half. */
+#ifndef LCD_DUAL_QUEUE
+#define LCD_DUAL_QUEUE 512
+#endif
+
+/**
+ * The dual controller structure.
+ */
+typedef struct lcdDual_t
+{
+    lcdDriver_t halves[2];          /** Drivers of rows 0-1 and rows 2-3, each enabling its own controller. */
+
+    /* private to implementation, modify at your own risk. */
+    uint8_t active;                 /** Half the cursor is in. */
+    lcdDriver_t *drivers[2];
+    lcdMulti_t multi;
+    lcdBusStep_t queues[2][LCD_DUAL_QUEUE];
+} lcdDual_t;
+
+/**
+ * Initialize both controllers.
+ * @param dual The dual controller structure, with the bus, timing and mode of both halves set.
+ * @param width Width of the display.
+ * @return Non-zero value on error.
+ * @remarks The halves are made buffered, text only reaches the display with lcdDualFlush.
+ */
+int lcdDualInit(lcdDual_t *dual, uint8_t width);
+
+/**
+ * Set the display mode of both controllers.
+ * @see int lcdSetDisplay(lcdDriver_t*,bool,bool,bool)
+ * @remarks The cursor is only shown by the half holding it at the time of the call.
+ */
+int lcdDualSetDisplay(lcdDual_t *dual, bool display, bool cursor, bool blink);
+
+/**
+ * Store a custom glyph in both controllers.
+ * @see int lcdStoreGlyph(lcdDriver_t*,char,const uint8_t*)
+ */
+int lcdDualStoreGlyph(lcdDual_t *dual, char which, const uint8_t *bits);
+
+/**
+ * Clear the shadow display RAM of both halves and home the cursor.
+ * @param dual The dual controller structure.
+ * @return Non-zero value on error.
+ */
+int lcdDualClear(lcdDual_t *dual);
+
+/**
+ * Set the cursor position.
+ * @param dual The dual controller structure.
+ * @param column The column.
+ * @param row The row, 0-3.
+ * @return Non-zero value on error.
+ */
+int lcdDualSetCursor(lcdDual_t *dual, uint8_t column, uint8_t row);
+
+/**
+ * Put a string at the cursor, continuing in the other half past its last row.
+ * @param dual The dual controller structure.
+ * @param str The string.
+ * @param length Length of the string.
+ * @return Non-zero value on error.
+ */
+int lcdDualPutString(lcdDual_t *dual, const char *str, size_t length);
+
+/**
+ * Put a null terminated string at the cursor.
+ * @see int lcdDualPutString(lcdDual_t*,const char*,size_t)
+ */
+#define lcdDualPutZString(dual, str) lcdDualPutString(dual, str, strlen(str))
+
+/**
+ * Send the changes of both halves.
+ * @param dual The dual controller structure.
+ * @return Non-zero value on error.
+ * @remarks Write only halves are flushed interleaved, read-write ones one after the other.
+ * The interleaving is driven by lcdMultiPoll on the now clock of the first
+ * half. Without one, time is taken to pass exactly as the lcdDelay calls of
+ * the first half request, so a delay that returns early shortens the waits.
+ */
+int lcdDualFlush(lcdDual_t *dual);
+
+#endif
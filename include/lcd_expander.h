@@ -0,0 +1,121 @@
+#ifndef _LCD_EXPANDER_H_
+#define _LCD_EXPANDER_H_
+
+/**
+ * @file lcd_expander.h 8-bit port expander bus backend.
+ *
+ * Drives the LCD in 4-bit mode through an 8-bit output port, such as a
+ * PCF8574 I2C backpack or a 74HC595 shift register. Every bus step becomes
+ * one port byte, and delays are covered by the time the following bytes take
+ * on the wire, so whole sequences go out in a single transfer.
+ */
+
+#include "lcd.h"
+
+/** Size of the transfer buffer in bytes, the longest maxLength. */
+#ifndef LCD_EXPANDER_BUFFER
+#define LCD_EXPANDER_BUFFER 512
+#endif
+
+/** Default number of repeated bytes used to wait, see lcdExpander_t.maxPadding. */
+#define LCD_EXPANDER_MAX_PADDING 4
+
+typedef struct lcdExpander_t lcdExpander_t;
+
+/**
+ * Send bytes to the port, each byte being one output state.
+ * @param expander The expander structure.
+ * @param data The bytes.
+ * @param length Number of bytes.
+ * @return Non-negative if successful, negative on error.
+ */
+typedef int (*lcdExpanderTransmitHandler_t)(lcdExpander_t *expander, const uint8_t *data, size_t length);
+
+/**
+ * Port bits of the LCD pins.
+ */
+typedef struct lcdExpanderPins_t
+{
+    uint8_t rs;                     /** Register select bit. */
+    uint8_t rw;                     /** Read/Write bit. */
+    uint8_t en;                     /** Enable bit. */
+    uint8_t backlight;              /** Backlight bit. */
+    uint8_t data[4];                /** D4-D7 bits. */
+} lcdExpanderPins_t;
+
+/**
+ * The expander structure.
+ */
+struct lcdExpander_t
+{
+    lcdExpanderPins_t pins;         /** Port bits of the LCD pins. */
+    bool backlight;                 /** Backlight state. */
+    uint32_t byteTime;              /** Time between two output updates, in nanoseconds. */
+    uint8_t leadBytes;              /** Byte times from the start of a transfer to its first output update. */
+    uint8_t maxPadding;             /** Most repeated bytes used to wait, longer waits end the transfer and delay. */
+    uint16_t maxLength;             /** Most bytes per transfer, at most LCD_EXPANDER_BUFFER. */
+    lcdExpanderTransmitHandler_t transmit;  /** Transfer function. */
+    void *userData;                 /** Storage for your usage */
+
+    /* private to implementation, modify at your own risk. */
+    uint8_t buffer[LCD_EXPANDER_BUFFER];
+    uint16_t length;
+    uint8_t port;                   /** Last output state. */
+};
+
+/**
+ * Convert pin states into a port byte.
+ * @param expander The expander structure.
+ * @param rw Read/Write pin state.
+ * @param rs Register select pin state.
+ * @param en Enable pin state.
+ * @param data Data bus, D4-D7 in the top nibble.
+ * @return The port byte.
+ */
+inline static uint8_t lcdExpanderPack(const lcdExpander_t *expander, bool rw, bool rs, bool en, uint8_t data)
+{
+    const lcdExpanderPins_t *pins = &expander->pins;
+    return
+        (rs << pins->rs) | (rw << pins->rw) | (en << pins->en) | (expander->backlight << pins->backlight) |
+        (((data >> 4) & 1) << pins->data[0]) | (((data >> 5) & 1) << pins->data[1]) |
+        (((data >> 6) & 1) << pins->data[2]) | (((data >> 7) & 1) << pins->data[3]);
+}
+
+/**
+ * Convert a port byte into the data bus.
+ * @param expander The expander structure.
+ * @param port The port byte.
+ * @return The data bus, D4-D7 in the top nibble.
+ */
+inline static uint8_t lcdExpanderUnpack(const lcdExpander_t *expander, uint8_t port)
+{
+    const lcdExpanderPins_t *pins = &expander->pins;
+    return
+        (((port >> pins->data[0]) & 1) << 4) | (((port >> pins->data[1]) & 1) << 5) |
+        (((port >> pins->data[2]) & 1) << 6) | (((port >> pins->data[3]) & 1) << 7);
+}
+
+/**
+ * Send the buffered bytes.
+ * @param expander The expander structure.
+ * @return Non-zero if unsuccessful.
+ */
+int lcdExpanderFlush(lcdExpander_t *expander);
+
+/**
+ * Bus IO handler for a write only driver using the expander as user data,
+ * sends the pin states as a transfer of one byte.
+ * @see lcdBusIOHandler_t
+ */
+int lcdExpanderBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data);
+
+/**
+ * Batch handler for a driver using the expander as user data.
+ * @see lcdBusBatchHandler_t
+ * @remarks Delays shorter than maxPadding bytes are covered by repeating the
+ * output state, longer ones end the transfer and call lcdDelay. Steps only
+ * setting up data for a rising enable are folded into that edge.
+ */
+int lcdExpanderBatch(lcdDriver_t *driver, const lcdBusStep_t *steps, size_t count, bool more);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef _LCD_GLYPH_H_
+#define _LCD_GLYPH_H_
+
+/**
+ * @file lcd_glyph.h Cache of custom glyphs in character RAM.
+ *
+ * Maps application glyph IDs to the 8 character RAM slots (4 with the large
+ * font). A glyph is only uploaded when it is not in a slot yet or its bits
+ * changed. Slots shown by a cell of the display are never evicted, among the
+ * others the least recently used one is replaced.
+ */
+
+#include "lcd.h"
+
+/** Number of character RAM slots. */
+#define LCD_GLYPH_SLOTS 8
+
+/**
+ * The glyph cache structure.
+ */
+typedef struct lcdGlyphCache_t
+{
+    lcdDriver_t *driver;            /** The driver, which must be buffered. */
+
+    /* private to implementation, modify at your own risk. */
+    struct {
+        bool used;                  /** The slot holds a glyph. */
+        uint16_t id;                /** Application ID of the glyph. */
+        uint32_t lastUse;           /** Time of the last use, in uses of the cache. */
+        uint8_t bits[10];           /** Rows of the glyph as uploaded. */
+    } slots[LCD_GLYPH_SLOTS];
+    uint32_t uses;                  /** Uses of the cache so far. */
+} lcdGlyphCache_t;
+
+/**
+ * Initialize a glyph cache with all slots free.
+ * @param cache The glyph cache structure.
+ * @param driver The driver, which must be buffered.
+ * @remarks Storing glyphs with int lcdStoreGlyph(lcdDriver_t*,char,const uint8_t*)
+ * on the same driver bypasses the cache, do not mix the two.
+ */
+void lcdGlyphInit(lcdGlyphCache_t *cache, lcdDriver_t *driver);
+
+/**
+ * Get the character code of a glyph, uploading it if needed.
+ * @param cache The glyph cache structure.
+ * @param id Application ID of the glyph.
+ * @param bits Rows of the glyph, 8 or 10 with the large font.
+ * @return The character code, 8-15 so it can be put in strings, or negative
+ * on error. Updates errno, to ENOSPC if every slot is shown on the display.
+ * @remarks Changed bits of a cached glyph are uploaded again, which also
+ * changes the cells already showing it. Cells overwritten since the last
+ * flush still hold their slot until the next one.
+ */
+int lcdGlyphGet(lcdGlyphCache_t *cache, uint16_t id, const uint8_t *bits);
+
+/**
+ * Put a glyph at the cursor.
+ * @param cache The glyph cache structure.
+ * @param id Application ID of the glyph.
+ * @param bits Rows of the glyph, 8 or 10 with the large font.
+ * @return Non-zero value on error. Updates errno.
+ * @see int lcdGlyphGet(lcdGlyphCache_t*,uint16_t,const uint8_t*)
+ */
+int lcdGlyphPut(lcdGlyphCache_t *cache, uint16_t id, const uint8_t *bits);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef _LCD_MARQUEE_H_
+#define _LCD_MARQUEE_H_
+
+/**
+ * @file lcd_marquee.h Scrolling text using the display shift of the LCD.
+ *
+ * The text of each line is loaded into display RAM once, and every step is a
+ * single display shift command. Texts longer than a display RAM line are
+ * streamed in one character per step, into the column that just went out of
+ * view.
+ */
+
+#include "lcd.h"
+
+/**
+ * The marquee structure.
+ */
+typedef struct lcdMarquee_t
+{
+    lcdDriver_t *driver;            /** The driver. */
+
+    /* private to implementation, modify at your own risk. */
+    struct {
+        const char *text;           /** Text of the line, NULL when it is not streamed. */
+        size_t length;              /** Length of the text. */
+        size_t next;                /** Index of the character streamed in next. */
+        uint8_t column;             /** Column the next character goes into, the shift when up to date. */
+    } lines[2];
+    uint8_t shift;                  /** Display shift, the column shown first. */
+} lcdMarquee_t;
+
+/**
+ * Start a marquee, homing the display shift.
+ * @param marquee The marquee structure.
+ * @param driver The driver, with one or two rows in the standard layout.
+ * @return Non-zero value on error. Updates errno.
+ * @remarks While the display is shifted, positions given to the other calls
+ * are display RAM columns and scroll along.
+ */
+int lcdMarqueeStart(lcdMarquee_t *marquee, lcdDriver_t *driver);
+
+/**
+ * Load the text of a row, starting at the left of the display.
+ * @param marquee The marquee structure.
+ * @param row The row.
+ * @param text The text, kept by the caller as long as it scrolls if longer than a display RAM line.
+ * @param length Length of the text.
+ * @return Non-zero value on error. Updates errno.
+ * @remarks Shorter texts are padded with spaces to a display RAM line, and
+ * go round once per line length.
+ */
+int lcdMarqueeSetText(lcdMarquee_t *marquee, uint8_t row, const char *text, size_t length);
+
+/**
+ * Scroll the display one column to the left.
+ * @param marquee The marquee structure.
+ * @return Non-zero value on error. Updates errno.
+ * @remarks One command, plus an address set and a write for each row streaming a long text.
+ */
+int lcdMarqueeStep(lcdMarquee_t *marquee);
+
+/**
+ * Stop a marquee, homing the display shift.
+ * @param marquee The marquee structure.
+ * @return Non-zero value on error. Updates errno.
+ */
+int lcdMarqueeStop(lcdMarquee_t *marquee);
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef _LCD_MULTI_H_
+#define _LCD_MULTI_H_
+
+/**
+ * @file lcd_multi.h Scheduler for displays sharing a bus.
+ *
+ * Several LCDs can share RS, R/W and the data lines, each with its own enable
+ * line. The drivers run in non-blocking mode, and while one display is
+ * executing an instruction the scheduler strobes the next byte into another,
+ * so the displays' busy times overlap instead of adding up.
+ */
+
+#include "lcd.h"
+
+/**
+ * The scheduler structure.
+ */
+typedef struct lcdMulti_t
+{
+    lcdDriver_t **drivers;          /** The drivers, write only and with a queue each. */
+    uint8_t count;                  /** Number of drivers. */
+
+    /* private to implementation, modify at your own risk. */
+    int8_t owner;                   /** Driver in the middle of an enable strobe, or -1. */
+    uint8_t next;                   /** Driver to look at first, for fairness. */
+    bool enabled;                   /** The owner has its enable line high. */
+    uint64_t free;                  /** Time the shared lines may change, in microseconds. */
+} lcdMulti_t;
+
+/**
+ * Initialize a scheduler.
+ * @param multi The scheduler structure.
+ * @param drivers The drivers. Their bus IO handlers drive the shared lines and their own enable line.
+ * @param count Number of drivers.
+ */
+void lcdMultiInit(lcdMulti_t *multi, lcdDriver_t **drivers, uint8_t count);
+
+/**
+ * Execute the queued bus steps of all drivers that are due.
+ * @param multi The scheduler structure.
+ * @param now Current time in microseconds, from a monotonic clock.
+ * @return Time the next step is due in microseconds, LCD_POLL_IDLE if all
+ * queues are empty, negative on error.
+ * @remarks Use in place of lcdPoll for the drivers. A driver keeps the shared
+ * lines from setting them up until its enable falls and the data hold time has
+ * passed, the others are served in turn during its delays.
+ */
+int64_t lcdMultiPoll(lcdMulti_t *multi, uint64_t now);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef _LCD_PCF8574_H_
+#define _LCD_PCF8574_H_
+
+/**
+ * @file lcd_pcf8574.h PCF8574 I2C backpack backend.
+ *
+ * The common backpacks wire P0=RS, P1=R/W, P2=EN, P3=backlight and P4-P7 to
+ * D4-D7. The PCF8574 updates its outputs at the acknowledge of every byte, so
+ * whole strings are written as a few long I2C transactions.
+ */
+
+#include "lcd_expander.h"
+
+/** Usual address of the PCF8574 backpacks, 0x3F for the PCF8574A. */
+#define LCD_PCF8574_ADDRESS 0x27
+
+/** Pin map of the common backpacks. */
+#define LCD_PCF8574_PINS { .rs = 0, .rw = 1, .en = 2, .backlight = 3, .data = { 4, 5, 6, 7 } }
+
+/**
+ * I2C write function.
+ * @param bus Bus handle given to lcdPcf8574Init.
+ * @param address 7-bit device address.
+ * @param data The bytes.
+ * @param length Number of bytes.
+ * @return Non-negative if successful, negative on error.
+ */
+typedef int (*lcdI2CWriteHandler_t)(void *bus, uint8_t address, const uint8_t *data, size_t length);
+
+/**
+ * I2C read function.
+ * @param bus Bus handle given to lcdPcf8574Init.
+ * @param address 7-bit device address.
+ * @param data Where the bytes go.
+ * @param length Number of bytes.
+ * @return Non-negative if successful, negative on error.
+ */
+typedef int (*lcdI2CReadHandler_t)(void *bus, uint8_t address, uint8_t *data, size_t length);
+
+/**
+ * The backpack structure.
+ */
+typedef struct lcdPcf8574_t
+{
+    lcdExpander_t expander;         /** The port, must be the first member. */
+    uint8_t address;                /** 7-bit device address. */
+    lcdI2CWriteHandler_t write;     /** I2C write function. */
+    lcdI2CReadHandler_t read;       /** I2C read function, NULL for write only drivers. */
+    void *bus;                      /** I2C bus handle. */
+} lcdPcf8574_t;
+
+/**
+ * Initialize a backpack structure with the common pin map.
+ * @param backpack The backpack structure.
+ * @param address 7-bit device address.
+ * @param clock I2C clock in Hz.
+ * @param maxLength Most bytes the I2C driver accepts in one write, at most LCD_EXPANDER_BUFFER.
+ * @param write I2C write function.
+ * @param read I2C read function, NULL for write only drivers.
+ * @param bus I2C bus handle.
+ */
+void lcdPcf8574Init(lcdPcf8574_t *backpack, uint8_t address, uint32_t clock, uint16_t maxLength,
+    lcdI2CWriteHandler_t write, lcdI2CReadHandler_t read, void *bus);
+
+/**
+ * Attach a backpack to a driver, replacing its user data, bus IO and batch handlers.
+ * @param backpack The backpack structure.
+ * @param driver The driver, which must be in 4-bit mode.
+ */
+void lcdPcf8574Attach(lcdPcf8574_t *backpack, lcdDriver_t *driver);
+
+/**
+ * Bus IO handler for a driver using the backpack as user data.
+ * @see lcdBusIOHandler_t
+ */
+int lcdPcf8574BusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data);
+
+/**
+ * Switch the backlight.
+ * @param driver The driver.
+ * @param on Backlight state.
+ * @return Non-zero if unsuccessful.
+ */
+int lcdPcf8574Backlight(lcdDriver_t *driver, bool on);
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef _LCD_WAVE_H_
+#define _LCD_WAVE_H_
+
+/**
+ * @file lcd_wave.h Parallel waveform encoder.
+ *
+ * Turns bus steps into a buffer of parallel pin states sampled at a fixed
+ * period, the format I2S and LCD parallel DMA peripherals clock out. Each step
+ * is held for as many samples as its delay needs, so a whole command or string
+ * becomes one frame for the peripheral instead of one lcdDelay per edge.
+ */
+
+#include "lcd.h"
+
+/** Samples, one bit per pin. */
+typedef uint16_t lcdWaveSample_t;
+
+typedef struct lcdWave_t lcdWave_t;
+
+/**
+ * Queue a frame of samples for output.
+ * @param wave The encoder structure.
+ * @param samples The samples.
+ * @param length Number of samples.
+ * @return Non-negative if successful, negative on error.
+ * @remarks The frame may still be playing when this returns, but the samples
+ * are overwritten by the next frame: copy them into the peripheral's queue,
+ * or return only once the DMA has read them. Frames play back to back and the
+ * peripheral must hold the last sample until the next one. The encoder keeps
+ * count of the queued time and waits it out only before a direct bus access
+ * or a delay longer than maxHold.
+ */
+typedef int (*lcdWaveSubmitHandler_t)(lcdWave_t *wave, const lcdWaveSample_t *samples, size_t length);
+
+/**
+ * Sample bits of the LCD pins.
+ */
+typedef struct lcdWavePins_t
+{
+    uint8_t rs;                     /** Register select bit. */
+    uint8_t rw;                     /** Read/Write bit. */
+    uint8_t en;                     /** Enable bit. */
+    uint8_t data[8];                /** D0-D7 bits, only D4-D7 are used in 4-bit mode. */
+} lcdWavePins_t;
+
+/** Data bus on the low byte, control lines above it. */
+#define LCD_WAVE_PINS { .rs = 8, .rw = 9, .en = 10, .data = { 0, 1, 2, 3, 4, 5, 6, 7 } }
+
+/**
+ * The encoder structure.
+ */
+struct lcdWave_t
+{
+    lcdWavePins_t pins;             /** Sample bits of the LCD pins. */
+    uint32_t samplePeriod;          /** Time of a sample, in nanoseconds. */
+    uint32_t maxHold;               /** Longest delay encoded as samples in microseconds, longer ones end the frame and call lcdDelay. */
+    lcdWaveSubmitHandler_t submit;  /** Frame output function. */
+    lcdWaveSample_t *samples;       /** Frame buffer. */
+    size_t capacity;                /** Frame buffer size in samples. */
+    void *userData;                 /** Storage for your usage */
+
+    /* private to implementation, modify at your own risk. */
+    size_t length;
+    uint64_t pending;               /** When the submitted samples have played in nanoseconds, on the driver clock or since the last wait. */
+};
+
+/**
+ * Convert pin states into a sample.
+ * @param wave The encoder structure.
+ * @param rw Read/Write pin state.
+ * @param rs Register select pin state.
+ * @param en Enable pin state.
+ * @param data Data bus.
+ * @return The sample.
+ */
+inline static lcdWaveSample_t lcdWavePack(const lcdWave_t *wave, bool rw, bool rs, bool en, uint8_t data)
+{
+    lcdWaveSample_t sample = (rs << wave->pins.rs) | (rw << wave->pins.rw) | (en << wave->pins.en);
+    for (int i = 0; i < 8; i++)
+        sample |= ((data >> i) & 1) << wave->pins.data[i];
+    return sample;
+}
+
+/**
+ * Number of samples a step takes.
+ * @param wave The encoder structure.
+ * @param step The bus step.
+ * @return At least one sample, enough to cover the step delay.
+ */
+inline static size_t lcdWaveLength(const lcdWave_t *wave, const lcdBusStep_t *step)
+{
+    uint64_t delay = (uint64_t)step->delay * 1000;
+    size_t length = (delay + wave->samplePeriod - 1) / wave->samplePeriod;
+    return length ? length : 1;
+}
+
+/**
+ * Encode bus steps into samples.
+ * @param wave The encoder structure.
+ * @param steps The bus steps.
+ * @param count Number of steps.
+ * @param samples Where the samples go.
+ * @param capacity Size of samples.
+ * @return Number of samples written, or zero if they did not fit.
+ */
+size_t lcdWaveEncode(const lcdWave_t *wave, const lcdBusStep_t *steps, size_t count, lcdWaveSample_t *samples, size_t capacity);
+
+/**
+ * Initialize an encoder structure with LCD_WAVE_PINS.
+ * @param wave The encoder structure.
+ * @param samplePeriod Time of a sample, in nanoseconds.
+ * @param samples Frame buffer.
+ * @param capacity Frame buffer size in samples.
+ * @param submit Frame output function.
+ */
+void lcdWaveInit(lcdWave_t *wave, uint32_t samplePeriod, lcdWaveSample_t *samples, size_t capacity, lcdWaveSubmitHandler_t submit);
+
+/**
+ * Attach an encoder to a write only driver, replacing its user data, bus IO and batch handlers.
+ * @param wave The encoder structure.
+ * @param driver The driver.
+ */
+void lcdWaveAttach(lcdWave_t *wave, lcdDriver_t *driver);
+
+/**
+ * Bus IO handler for a write only driver using the encoder as user data,
+ * sends the pin states as a frame of one sample.
+ * @see lcdBusIOHandler_t
+ */
+int lcdWaveBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data);
+
+/**
+ * Batch handler for a driver using the encoder as user data.
+ * @see lcdBusBatchHandler_t
+ */
+int lcdWaveBatch(lcdDriver_t *driver, const lcdBusStep_t *steps, size_t count, bool more);
+
+#endif
@@ -0,0 +1,378 @@
+#include "lcd_sim.h"
+
+#include <string.h>
+
+/**
+ * Record a violation.
+ * @param sim The simulator.
+ * @param message Description of the violation.
+ */
+static void lcdSimViolate(lcdSim_t *sim, const char *message)
+{
+    sim->violations++;
+    sim->lastViolation = message;
+    if (sim->violation)
+        sim->violation(sim, message);
+}
+
+/**
+ * Length of a display RAM line in the current mode.
+ * @param sim The simulator.
+ * @return Number of bytes per line.
+ */
+static uint8_t lcdSimLineLength(const lcdSim_t *sim)
+{
+    return sim->twoLines ? LCD_DDRAM_LINE : LCD_DDRAM_SIZE;
+}
+
+/**
+ * Decode a display RAM address into an index into the display RAM.
+ * @param sim The simulator.
+ * @param address The display RAM address.
+ * @return The index, or negative if the address does not exist in the current mode.
+ */
+static int lcdSimIndex(const lcdSim_t *sim, uint8_t address)
+{
+    if (sim->twoLines)
+        return ((address & 0x3F) < LCD_DDRAM_LINE && address < 0x80) ? LCD_DDRAM_INDEX(address) : -1;
+    else
+        return (address < LCD_DDRAM_SIZE) ? address : -1;
+}
+
+/**
+ * Move the address counter by one.
+ * @param sim The simulator.
+ * @param forward True to increment, false to decrement.
+ */
+static void lcdSimStep(lcdSim_t *sim, bool forward)
+{
+    if (sim->cgramSelected)
+    {
+        sim->address = (sim->address + (forward ? 1 : -1)) & (LCD_SIM_CGRAM_SIZE - 1);
+    }
+    else if (sim->twoLines)
+    {
+        if (forward)
+            sim->address = (sim->address == 0x27) ? 0x40 : (sim->address == 0x67) ? 0x00 : sim->address + 1;
+        else
+            sim->address = (sim->address == 0x40) ? 0x27 : (sim->address == 0x00) ? 0x67 : sim->address - 1;
+    }
+    else
+    {
+        if (forward)
+            sim->address = (sim->address == 0x4F) ? 0x00 : sim->address + 1;
+        else
+            sim->address = (sim->address == 0x00) ? 0x4F : sim->address - 1;
+    }
+}
+
+/**
+ * Shift the display by one.
+ * @param sim The simulator.
+ * @param left True to move the contents to the left.
+ */
+static void lcdSimShift(lcdSim_t *sim, bool left)
+{
+    uint8_t length = lcdSimLineLength(sim);
+    sim->displayShift = (sim->displayShift + (left ? 1 : length - 1)) % length;
+}
+
+/**
+ * Execute an instruction.
+ * @param sim The simulator.
+ * @param command The instruction byte.
+ */
+static void lcdSimCommand(lcdSim_t *sim, uint8_t command)
+{
+    uint32_t execute = sim->timing.execute;
+
+    sim->counters.commands++;
+    if (command & 0x80)
+    {
+        sim->address = command & 0x7F;
+        sim->cgramSelected = false;
+        if (lcdSimIndex(sim, sim->address) < 0)
+            lcdSimViolate(sim, "Display RAM address does not exist");
+    }
+    else if (command & 0x40)
+    {
+        sim->address = command & 0x3F;
+        sim->cgramSelected = true;
+    }
+    else if (command & 0x20)
+    {
+        bool eightBit = !!(command & 0x10);
+        if (sim->eightBit && !eightBit)
+            sim->secondNibble = false;
+        sim->eightBit = eightBit;
+        sim->twoLines = !!(command & 0x08);
+        sim->largeFont = !!(command & 0x04);
+    }
+    else if (command & 0x10)
+    {
+        if (command & 0x08)
+            lcdSimShift(sim, !(command & 0x04));
+        else
+            lcdSimStep(sim, !!(command & 0x04));
+    }
+    else if (command & 0x08)
+    {
+        sim->displayOn = !!(command & 0x04);
+        sim->cursorOn = !!(command & 0x02);
+        sim->blinkOn = !!(command & 0x01);
+    }
+    else if (command & 0x04)
+    {
+        sim->increment = !!(command & 0x02);
+        sim->shift = !!(command & 0x01);
+    }
+    else if (command & 0x02)
+    {
+        sim->address = 0;
+        sim->cgramSelected = false;
+        sim->displayShift = 0;
+        execute = sim->timing.executeLong;
+    }
+    else if (command & 0x01)
+    {
+        memset(sim->ddram, ' ', sizeof(sim->ddram));
+        sim->address = 0;
+        sim->cgramSelected = false;
+        sim->displayShift = 0;
+        sim->increment = true;
+        execute = sim->timing.executeLong;
+    }
+
+    sim->busyUntil = sim->now + execute;
+}
+
+/**
+ * Write a byte to display or character RAM.
+ * @param sim The simulator.
+ * @param data The data byte.
+ */
+static void lcdSimWrite(lcdSim_t *sim, uint8_t data)
+{
+    sim->counters.writes++;
+    if (sim->cgramSelected)
+    {
+        sim->cgram[sim->address & (LCD_SIM_CGRAM_SIZE - 1)] = data;
+    }
+    else
+    {
+        int index = lcdSimIndex(sim, sim->address);
+        if (index >= 0)
+            sim->ddram[index] = data;
+        if (sim->shift)
+            lcdSimShift(sim, sim->increment);
+    }
+
+    lcdSimStep(sim, sim->increment);
+    sim->busyUntil = sim->now + sim->timing.execute;
+}
+
+/**
+ * Get the value the controller puts on the bus for a read.
+ * @param sim The simulator.
+ * @param rs Register select.
+ * @return The byte to be read.
+ */
+static uint8_t lcdSimOutput(lcdSim_t *sim, bool rs)
+{
+    if (!rs)
+    {
+        sim->counters.statusReads++;
+        return ((sim->now < sim->busyUntil) ? 0x80 : 0x00) | (sim->address & 0x7F);
+    }
+
+    if (sim->now < sim->busyUntil)
+        lcdSimViolate(sim, "Data read while busy");
+
+    if (sim->cgramSelected)
+    {
+        return sim->cgram[sim->address & (LCD_SIM_CGRAM_SIZE - 1)];
+    }
+    else
+    {
+        int index = lcdSimIndex(sim, sim->address);
+        return (index >= 0) ? sim->ddram[index] : 0xFF;
+    }
+}
+
+void lcdSimInit(lcdSim_t *sim, uint8_t width, uint8_t height, bool fourWires)
+{
+    assert(sim);
+    assert(height <= 4);
+
+    memset(sim, 0, sizeof(*sim));
+    sim->dimensions.width = width;
+    sim->dimensions.height = height;
+    sim->rowBase[0] = 0x00;
+    sim->rowBase[1] = 0x40;
+    sim->rowBase[2] = width;
+    sim->rowBase[3] = 0x40 + width;
+    sim->split = width;
+    sim->fourWires = fourWires;
+
+    sim->timing.addressSetup = LCD_SIM_TIMING_ADDRESS_SETUP;
+    sim->timing.enablePulse  = LCD_SIM_TIMING_ENABLE_PULSE;
+    sim->timing.enableCycle  = LCD_SIM_TIMING_ENABLE_CYCLE;
+    sim->timing.dataSetup    = LCD_SIM_TIMING_DATA_SETUP;
+    sim->timing.hold         = LCD_SIM_TIMING_HOLD;
+    sim->timing.dataDelay    = LCD_SIM_TIMING_DATA_DELAY;
+    sim->timing.execute      = LCD_SIM_TIMING_EXECUTE;
+    sim->timing.executeLong  = LCD_SIM_TIMING_EXECUTE_LONG;
+
+    // The internal reset leaves the controller cleared, in 8-bit one line mode.
+    memset(sim->ddram, ' ', sizeof(sim->ddram));
+    sim->eightBit = true;
+    sim->increment = true;
+}
+
+void lcdSimAttach(lcdSim_t *sim, lcdDriver_t *driver)
+{
+    assert(sim);
+    assert(driver);
+
+    driver->userData = sim;
+    driver->busIO = lcdSimBusIO;
+    driver->delay = lcdSimDelay;
+}
+
+int lcdSimPins(lcdSim_t *sim, bool rw, bool rs, bool en, uint8_t data)
+{
+    assert(sim);
+
+    if (sim->fourWires)
+        data &= 0xF0;
+
+    bool rise = en && !sim->en;
+    bool fall = !en && sim->en;
+    bool controlChange = (rw != sim->rw) || (rs != sim->rs);
+    bool dataChange = !rw && (data != sim->data);
+
+    // Check the bus only changes where it is allowed to.
+    if (sim->en)
+    {
+        if (controlChange)
+            lcdSimViolate(sim, "RS or R/W changed while enable is high");
+        if (dataChange && !sim->rw)
+            lcdSimViolate(sim, "Data changed while enable is high");
+    }
+    else if ((controlChange || dataChange) && sim->counters.strobes && sim->now - sim->enableFall < sim->timing.hold)
+    {
+        lcdSimViolate(sim, "Bus changed before hold time");
+    }
+
+    if (controlChange)
+        sim->controlChanged = sim->now;
+    if (dataChange)
+    {
+        sim->dataChanged = sim->now;
+        sim->data = data;
+    }
+    sim->rw = rw;
+    sim->rs = rs;
+    sim->en = en;
+
+    if (rise)
+    {
+        if (sim->now - sim->controlChanged < sim->timing.addressSetup)
+            lcdSimViolate(sim, "Address set-up time");
+        if (sim->counters.strobes && sim->now - sim->enableRise < sim->timing.enableCycle)
+            lcdSimViolate(sim, "Enable cycle time");
+
+        sim->enableRise = sim->now;
+        sim->counters.strobes++;
+
+        // The whole byte is fetched on the first transfer.
+        if (rw && (sim->eightBit || !sim->secondNibble))
+            sim->output = lcdSimOutput(sim, rs);
+    }
+    else if (fall)
+    {
+        if (sim->now - sim->enableRise < sim->timing.enablePulse)
+            lcdSimViolate(sim, "Enable pulse width");
+        sim->enableFall = sim->now;
+
+        if (!rw && sim->now - sim->dataChanged < sim->timing.dataSetup)
+            lcdSimViolate(sim, "Data set-up time");
+
+        if (!sim->eightBit && !sim->secondNibble)
+        {
+            sim->nibble = sim->data & 0xF0;
+            sim->secondNibble = true;
+        }
+        else
+        {
+            uint8_t value = sim->eightBit ? sim->data : (sim->nibble | (sim->data >> 4));
+            sim->secondNibble = false;
+
+            if (!rw && sim->now < sim->busyUntil)
+                lcdSimViolate(sim, rs ? "Data written while busy" : "Instruction written while busy");
+
+            if (!rw && rs)
+                lcdSimWrite(sim, value);
+            else if (!rw)
+                lcdSimCommand(sim, value);
+            else if (rs)
+            {
+                sim->counters.reads++;
+                lcdSimStep(sim, sim->increment);
+                sim->busyUntil = sim->now + sim->timing.execute;
+            }
+        }
+    }
+    else if (rw && en && sim->now - sim->enableRise < sim->timing.dataDelay)
+    {
+        lcdSimViolate(sim, "Data read before it is valid");
+    }
+
+    if (!rw || !en)
+        return 0;
+
+    uint8_t value = (sim->eightBit || !sim->secondNibble) ? sim->output : (uint8_t)(sim->output << 4);
+    return sim->fourWires ? (value & 0xF0) : value;
+}
+
+void lcdSimAdvance(lcdSim_t *sim, uint64_t ns)
+{
+    assert(sim);
+    sim->now += ns;
+}
+
+int lcdSimBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    return lcdSimPins(driver->userData, rw, rs, en, data);
+}
+
+int lcdSimDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    lcdSimAdvance(driver->userData, (uint64_t)delay * 1000);
+    return 0;
+}
+
+uint8_t lcdSimPeek(const lcdSim_t *sim, uint8_t address)
+{
+    assert(sim);
+    int index = lcdSimIndex(sim, address);
+    return (index >= 0) ? sim->ddram[index] : 0xFF;
+}
+
+void lcdSimGetRow(const lcdSim_t *sim, uint8_t row, char *text)
+{
+    assert(sim);
+    assert(row < sim->dimensions.height);
+    assert(text);
+
+    uint8_t length = lcdSimLineLength(sim);
+    for (uint8_t x = 0; x < sim->dimensions.width; x++)
+    {
+        // Each line shifts on its own, a split row shows two windows.
+        uint8_t address = sim->rowBase[row] + x + ((x >= sim->split) ? 0x40 - sim->split : 0);
+        uint8_t line = sim->twoLines ? (address & 0x40) : 0;
+        uint8_t start = sim->twoLines ? (address & 0x3F) : address;
+        text[x] = lcdSimPeek(sim, line | ((start + sim->displayShift) % length));
+    }
+    text[sim->dimensions.width] = 0;
+}
@@ -0,0 +1,175 @@
+#ifndef _LCD_SIM_H_
+#define _LCD_SIM_H_
+
+/**
+ * @file lcd_sim.h HD44780 controller simulator.
+ *
+ * A software model of the HD44780 that plugs into the driver as its bus and
+ * delay handlers. Time only advances through delays, so the simulator also
+ * measures how long the driver keeps the bus busy. Meant for host builds.
+ */
+
+#include "lcd.h"
+
+/** Number of character RAM bytes. */
+#define LCD_SIM_CGRAM_SIZE 64
+
+/** Minimum address set-up time before enable rises, in nanoseconds. */
+#define LCD_SIM_TIMING_ADDRESS_SETUP    40
+/** Minimum enable pulse width, in nanoseconds. */
+#define LCD_SIM_TIMING_ENABLE_PULSE     230
+/** Minimum enable cycle time, in nanoseconds. */
+#define LCD_SIM_TIMING_ENABLE_CYCLE     500
+/** Minimum data set-up time before enable falls, in nanoseconds. */
+#define LCD_SIM_TIMING_DATA_SETUP       80
+/** Minimum hold time after enable falls, in nanoseconds. */
+#define LCD_SIM_TIMING_HOLD             10
+/** Maximum data output delay after enable rises, in nanoseconds. */
+#define LCD_SIM_TIMING_DATA_DELAY       160
+/** Execution time of most instructions, in nanoseconds. */
+#define LCD_SIM_TIMING_EXECUTE          37000
+/** Execution time of clear and home, in nanoseconds. */
+#define LCD_SIM_TIMING_EXECUTE_LONG     1520000
+
+typedef struct lcdSim_t lcdSim_t;
+
+/**
+ * Called on every timing or protocol violation.
+ * @param sim The simulator.
+ * @param message Description of the violation.
+ */
+typedef void (*lcdSimViolationHandler_t)(lcdSim_t *sim, const char *message);
+
+/**
+ * The simulator structure.
+ */
+struct lcdSim_t
+{
+    struct {
+        uint8_t width;              /** Width of the module. */
+        uint8_t height;             /** Height of the module. */
+    } dimensions;                   /** Module dimensions. */
+    uint8_t rowBase[4];             /** Display RAM address of the first column of each row. */
+    uint8_t split;                  /** First column shown from the second line, width for none. */
+    bool fourWires;                 /** Only D4-D7 are wired, D0-D3 read as zero. */
+
+    struct {
+        uint32_t addressSetup;      /** Minimum time from RS and R/W change to enable rise. */
+        uint32_t enablePulse;       /** Minimum enable high time. */
+        uint32_t enableCycle;       /** Minimum time between two enable rises. */
+        uint32_t dataSetup;         /** Minimum time from data change to enable fall. */
+        uint32_t hold;              /** Minimum time from enable fall to a bus change. */
+        uint32_t dataDelay;         /** Time from enable rise until read data is valid. */
+        uint32_t execute;           /** Execution time of most instructions and data accesses. */
+        uint32_t executeLong;       /** Execution time of clear and home. */
+    } timing;                       /** Controller timing in nanoseconds, see LCD_SIM_TIMING_*. */
+
+    lcdSimViolationHandler_t violation; /** Optional handler called on violations. */
+    void *userData;                 /** Storage for your usage */
+
+    uint64_t now;                   /** Simulated time in nanoseconds. */
+    uint32_t violations;            /** Number of violations seen. */
+    const char *lastViolation;      /** Description of the last violation. */
+
+    struct {
+        uint32_t strobes;           /** Enable pulses. */
+        uint32_t commands;          /** Instructions executed. */
+        uint32_t writes;            /** Data bytes written. */
+        uint32_t reads;             /** Data bytes read. */
+        uint32_t statusReads;       /** Busy flag reads. */
+    } counters;                     /** Bus activity. */
+
+    /* Controller state. */
+    uint8_t ddram[LCD_DDRAM_SIZE];
+    uint8_t cgram[LCD_SIM_CGRAM_SIZE];
+    uint8_t address;                /** Address counter. */
+    bool cgramSelected;             /** Address counter points into character RAM. */
+    bool eightBit;                  /** Interface data length. */
+    bool twoLines;
+    bool largeFont;
+    bool increment;                 /** Entry mode direction. */
+    bool shift;                     /** Entry mode display shift. */
+    bool displayOn;
+    bool cursorOn;
+    bool blinkOn;
+    uint8_t displayShift;           /** Display shift to the left, 0-39. */
+    uint64_t busyUntil;             /** Time when the current instruction finishes. */
+
+    /* Bus state. */
+    bool rw, rs, en;
+    uint8_t data;
+    uint64_t controlChanged;        /** Last RS or R/W change. */
+    uint64_t dataChanged;           /** Last data change. */
+    uint64_t enableRise;            /** Last enable rise. */
+    uint64_t enableFall;            /** Last enable fall. */
+    bool secondNibble;              /** Next transfer is the low nibble in 4-bit mode. */
+    uint8_t nibble;                 /** High nibble of a 4-bit write. */
+    uint8_t output;                 /** Byte being read in 4-bit mode. */
+};
+
+/**
+ * Initialize the simulator to the power on state of the controller.
+ * @param sim The simulator.
+ * @param width Width of the module.
+ * @param height Height of the module.
+ * @param fourWires True if only D4-D7 are wired.
+ * @remarks Rows use the usual 0x00, 0x40, 0x00 + width, 0x40 + width layout,
+ * change rowBase and split after initialization for other modules.
+ */
+void lcdSimInit(lcdSim_t *sim, uint8_t width, uint8_t height, bool fourWires);
+
+/**
+ * Use the simulator as the bus of a driver.
+ * @param sim The simulator.
+ * @param driver The driver structure.
+ * @remarks Sets the userData, busIO and delay members of the driver.
+ */
+void lcdSimAttach(lcdSim_t *sim, lcdDriver_t *driver);
+
+/**
+ * Set the bus pins of the simulator.
+ * @param sim The simulator.
+ * @param rw Read/Write pin state.
+ * @param rs Register select pin state.
+ * @param en Enable pin state.
+ * @param data Data bus output, valid if rw is false.
+ * @return The data bus value if reading, zero otherwise.
+ */
+int lcdSimPins(lcdSim_t *sim, bool rw, bool rs, bool en, uint8_t data);
+
+/**
+ * Advance simulated time.
+ * @param sim The simulator.
+ * @param ns Time to advance in nanoseconds.
+ */
+void lcdSimAdvance(lcdSim_t *sim, uint64_t ns);
+
+/**
+ * Bus handler for a driver attached to a simulator.
+ * @see lcdBusIOHandler_t
+ */
+int lcdSimBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data);
+
+/**
+ * Delay handler for a driver attached to a simulator.
+ * @see lcdDelayHandler_t
+ */
+int lcdSimDelay(lcdDriver_t *driver, uint32_t delay);
+
+/**
+ * Read a byte of display RAM.
+ * @param sim The simulator.
+ * @param address The display RAM address.
+ * @return The byte at the address.
+ */
+uint8_t lcdSimPeek(const lcdSim_t *sim, uint8_t address);
+
+/**
+ * Get the text shown on a row, including display shift.
+ * @param sim The simulator.
+ * @param row The row.
+ * @param text Storage for width characters and a terminating zero.
+ */
+void lcdSimGetRow(const lcdSim_t *sim, uint8_t row, char *text);
+
+#endif
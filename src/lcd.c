@@ -1,5 +1,13 @@
 #include "lcd.h"
 
+#include <string.h>
+
+#if LCD_STATS
+#define LCD_STAT(expr) do { expr; } while (0)
+#else
+#define LCD_STAT(expr) do { } while (0)
+#endif
+
 /**
  * Control the LCD bus, write value and read.
  * @param driver The driver controlling the bus.
@@ -31,96 +39,362 @@ int WEAK lcdDelay(lcdDriver_t *driver, uint32_t delay)
     return driver->delay(driver, delay);
 }
 
-int lcdCommand(lcdDriver_t *driver, uint8_t command)
+/**
+ * Delay on behalf of the driver.
+ * @param driver The driver structure.
+ * @param delay Delay in microseconds.
+ * @return Zero for success, non-zero on failure.
+ * @remarks Keeps count of the requested delays in the driver statistics. With
+ * a clock, only moves the deadline the next bus access waits for.
+ */
+static int lcdSleep(lcdDriver_t *driver, uint32_t delay)
 {
-    // Write command into bus.
-    if (
-        lcdBusIO(driver, 0, 0, 0, command) < 0                  ||
-        lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-        lcdBusIO(driver, 0, 0, 1, command) < 0                  ||
-        lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-        lcdBusIO(driver, 0, 0, 0, command) < 0                  ||
-        lcdDelay(driver, driver->busTiming.dataHold)
-    )
+    LCD_STAT(driver->stats.delays++; driver->stats.delayTotal += delay);
+
+    if (driver->now)
+    {
+        uint64_t deadline = driver->now(driver) + delay;
+        if (deadline > driver->deadline)
+            driver->deadline = deadline;
+        return 0;
+    }
+
+    return lcdDelay(driver, delay);
+}
+
+/**
+ * Wait for what is left of the delays before the next bus access.
+ * @param driver The driver structure.
+ * @return Zero for success, non-zero on failure.
+ */
+static int lcdSettle(lcdDriver_t *driver)
+{
+    if (!driver->now)
+        return 0;
+
+    // Time spent since the delay was requested counts towards it.
+    uint64_t now = driver->now(driver);
+    if (now >= driver->deadline)
+        return 0;
+
+    uint32_t remaining = driver->deadline - now;
+    LCD_STAT(driver->stats.delaySlept += remaining);
+    return lcdDelay(driver, remaining);
+}
+
+/**
+ * Have the batch handler send the steps it holds back.
+ * @param driver The driver structure.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdBatchClose(lcdDriver_t *driver)
+{
+    if (!driver->batchHeld)
+        return 0;
+
+    driver->batchHeld = false;
+    if (driver->batch(driver, NULL, 0, false) < 0)
     {
         // IO failed.
         driver->error = EIO;
         return -1;
     }
 
-    if (driver->fourBits)
+    return 0;
+}
+
+/**
+ * Set the bus pins once the pending delays have passed.
+ * @see int lcdBusIO(lcdDriver_t*,bool,bool,bool,uint8_t)
+ */
+static int lcdPins(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    if (lcdBatchClose(driver) || lcdSettle(driver) != 0)
+        return -1;
+    return lcdBusIO(driver, rw, rs, en, data);
+}
+
+/**
+ * Start the statistics for a driver call.
+ * @param driver The driver structure.
+ * @return The clock time, or without a clock the total requested delay.
+ */
+static uint64_t lcdStatsBegin(lcdDriver_t *driver)
+{
+#if LCD_STATS
+    return driver->now ? driver->now(driver) : driver->stats.delayTotal;
+#else
+    (void)driver;
+    return 0;
+#endif
+}
+
+/**
+ * Finish the statistics for a driver call.
+ * @param driver The driver structure.
+ * @param start What lcdStatsBegin returned when the call started.
+ * @param result Result of the call.
+ * @return The result of the call.
+ */
+static int lcdStatsEnd(lcdDriver_t *driver, uint64_t start, int result)
+{
+#if LCD_STATS
+    uint64_t latency = lcdStatsBegin(driver) - start;
+    if (latency > driver->stats.maxLatency)
+        driver->stats.maxLatency = latency;
+    if (result < 0)
+        driver->stats.errors++;
+#else
+    (void)driver;
+    (void)start;
+#endif
+    return result;
+}
+
+/**
+ * Bus steps collected for the batch handler.
+ */
+typedef struct {
+    lcdBusStep_t steps[LCD_BATCH_STEPS];
+    size_t count;
+} lcdBatch_t;
+
+/**
+ * Hand the collected steps to the batch handler.
+ * @param driver The driver structure.
+ * @param batch The collected steps, emptied.
+ * @param more More steps follow right after, the handler may hold these back.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdBatchSubmit(lcdDriver_t *driver, lcdBatch_t *batch, bool more)
+{
+    if (!driver->batch || (batch->count == 0 && (more || !driver->batchHeld)))
+        return 0;
+
+    size_t count = batch->count;
+    batch->count = 0;
+    driver->batchHeld = more;
+    if (lcdSettle(driver) != 0 || driver->batch(driver, batch->steps, count, more) < 0)
     {
-        // Write bottom nibble of command into bus if in 4bit mode.
-        command <<= 4;
-        if (
-            lcdBusIO(driver, 0, 0, 0, command) < 0                  ||
-            lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-            lcdBusIO(driver, 0, 0, 1, command) < 0                  ||
-            lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-            lcdBusIO(driver, 0, 0, 0, command) < 0                  ||
-            lcdDelay(driver, driver->busTiming.dataHold)
-        )
+        // IO failed.
+        driver->error = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Execute the oldest queued step.
+ * @param driver The driver structure.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdStep(lcdDriver_t *driver)
+{
+    lcdBusStep_t *step = &driver->queue[driver->poll.head];
+    driver->poll.head = (driver->poll.head + 1) % driver->queueSize;
+    driver->poll.count--;
+    driver->poll.hold = step->delay;
+
+    if (lcdPins(driver, step->rw, step->rs, step->en, step->data) < 0)
+    {
+        // IO failed.
+        driver->error = EIO;
+        return -1;
+    }
+
+    // With a clock, the delay is due from now whoever executed the step.
+    if (driver->now)
+    {
+        driver->poll.due = driver->now(driver) + step->delay;
+        driver->poll.known = true;
+    }
+
+    return 0;
+}
+
+/**
+ * Wait for the delay after the last executed step.
+ * @param driver The driver structure.
+ * @return Non-zero if unsuccessful.
+ * @remarks With a clock, only what is left until the step is due.
+ */
+static int lcdStepHold(lcdDriver_t *driver)
+{
+    uint32_t hold = driver->poll.hold;
+    if (driver->now && driver->poll.known)
+    {
+        uint64_t now = driver->now(driver);
+        hold = (driver->poll.due > now) ? driver->poll.due - now : 0;
+    }
+    driver->poll.hold = 0;
+    driver->poll.known = false;
+
+    // Already counted when queued.
+    if (hold && lcdDelay(driver, hold) != 0)
+    {
+        driver->error = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Set the bus pins and delay, queue the step in non-blocking mode, or collect
+ * the step if there is a batch handler.
+ * @param driver The driver structure.
+ * @param batch The collected steps.
+ * @param rw Read/Write pin state.
+ * @param rs Register select pin state.
+ * @param en Enable pin state.
+ * @param data Data bus output.
+ * @param delay Delay after setting the pins, in microseconds.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdEmit(lcdDriver_t *driver, lcdBatch_t *batch, bool rw, bool rs, bool en, uint8_t data, uint32_t delay)
+{
+    if (driver->queue)
+    {
+        assert(driver->writeOnly);
+        assert(driver->queueSize);
+
+        // Queue full, make room the blocking way.
+        if (driver->poll.count == driver->queueSize && (lcdStepHold(driver) || lcdStep(driver)))
+            return -1;
+
+        lcdBusStep_t *step = &driver->queue[(driver->poll.head + driver->poll.count++) % driver->queueSize];
+        step->rw = rw;
+        step->rs = rs;
+        step->en = en;
+        step->data = data;
+        step->delay = delay;
+        LCD_STAT(if (delay) { driver->stats.delays++; driver->stats.delayTotal += delay; });
+        return 0;
+    }
+
+    if (!driver->batch)
+    {
+        if (lcdPins(driver, rw, rs, en, data) < 0 || (delay && lcdSleep(driver, delay) != 0))
         {
             // IO failed.
             driver->error = EIO;
             return -1;
         }
+        return 0;
     }
 
-    if (driver->writeOnly)
+    if (batch->count == LCD_BATCH_STEPS && lcdBatchSubmit(driver, batch, true))
+        return -1;
+
+    lcdBusStep_t *step = &batch->steps[batch->count++];
+    step->rw = rw;
+    step->rs = rs;
+    step->en = en;
+    step->data = data;
+    step->delay = delay;
+    LCD_STAT(if (delay) { driver->stats.delays++; driver->stats.delayTotal += delay; });
+    return 0;
+}
+
+/**
+ * Send a command or data byte on the bus.
+ * @param driver The driver structure.
+ * @param batch The collected steps.
+ * @param rs Register select, false for commands and true for data.
+ * @param value The byte to send.
+ * @param hold Extra delay after the byte, in microseconds.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdTransfer(lcdDriver_t *driver, lcdBatch_t *batch, bool rs, uint8_t value, uint32_t hold)
+{
+    // Write value into bus.
+    if (
+        lcdEmit(driver, batch, 0, rs, 0, value, driver->busTiming.addressSetup)                         ||
+        lcdEmit(driver, batch, 0, rs, 1, value, driver->busTiming.enableHold)                           ||
+        lcdEmit(driver, batch, 0, rs, 0, value, driver->busTiming.dataHold + (driver->fourBits ? 0 : hold))
+    )
     {
-        // Just do a dumb delay if in write only mode.
-        return lcdDelay(driver, driver->busTiming.busyHoldShort);
+        return -1;
     }
-    else
+
+    if (driver->fourBits)
     {
-        // Setup read from busy flag.
+        // Write bottom nibble of value into bus if in 4bit mode.
+        value <<= 4;
         if (
-            lcdBusIO(driver, 1, 0, 0, 0) < 0                        ||
-            lcdDelay(driver, driver->busTiming.addressSetup) != 0
+            lcdEmit(driver, batch, 0, rs, 0, value, driver->busTiming.addressSetup)                     ||
+            lcdEmit(driver, batch, 0, rs, 1, value, driver->busTiming.enableHold)                       ||
+            lcdEmit(driver, batch, 0, rs, 0, value, driver->busTiming.dataHold + hold)
         )
         {
-            // IO failed.
-            driver->error = EIO;
             return -1;
         }
+    }
 
-        int value = 0;
-        do {
-            if (
-                lcdDelay(driver, driver->busTiming.busyInterval) != 0   ||  // Delay before reading busy pin.
-                lcdBusIO(driver, 1, 0, 1, 0) < 0                        ||
-                lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-                (value = lcdBusIO(driver, 1, 0, 1, 0)) < 0              ||  // Read busy value.
-                lcdBusIO(driver, 1, 0, 0, 0) < 0                        ||
-                ((driver->fourBits) && (                                    // 4-bit mode extra ticks.
-                    lcdDelay(driver, driver->busTiming.dataHold) != 0   ||
-                    lcdBusIO(driver, 1, 0, 1, 0) < 0                    ||
-                    lcdDelay(driver, driver->busTiming.enableHold)      ||
-                    lcdBusIO(driver, 1, 0, 0, 0) < 0
-                ))
-            )
-            {
-                // IO failed.
-                driver->error = EIO;
-                return -1;
-            }
-        } while (value & (1 << 7)); // Busy flag is the 7th bit.
+    return 0;
+}
 
-        return lcdBusIO(driver, 0, 0, 0, 0);
+/**
+ * Read a byte from the bus.
+ * @param driver The driver structure.
+ * @param rs Register select, false for the busy flag and address counter and true for data.
+ * @return The byte read, negative on error.
+ * @remarks The read/write and register select lines must already be set up for reading.
+ */
+static int lcdReceive(lcdDriver_t *driver, bool rs)
+{
+    int high = 0;
+    int low = 0;
+    if (
+        lcdPins(driver, 1, rs, 1, 0) < 0                        ||
+        lcdSleep(driver, driver->busTiming.enableHold) != 0     ||
+        (high = lcdPins(driver, 1, rs, 1, 0)) < 0               ||  // Read value, top nibble in 4-bit mode.
+        lcdPins(driver, 1, rs, 0, 0) < 0                        ||
+        lcdSleep(driver, driver->busTiming.dataHold) != 0       ||
+        ((driver->fourBits) && (                                    // 4-bit mode extra ticks.
+            lcdPins(driver, 1, rs, 1, 0) < 0                    ||
+            lcdSleep(driver, driver->busTiming.enableHold) != 0 ||
+            (low = lcdPins(driver, 1, rs, 1, 0)) < 0            ||  // Read bottom nibble.
+            lcdPins(driver, 1, rs, 0, 0) < 0                    ||
+            lcdSleep(driver, driver->busTiming.dataHold) != 0
+        ))
+    )
+    {
+        // IO failed.
+        driver->error = EIO;
+        return -1;
     }
+
+    if (driver->fourBits)
+        return (high & 0xF0) | ((low >> 4) & 0x0F);
+    else
+        return high & 0xFF;
 }
 
-int lcdWrite(lcdDriver_t *driver, uint8_t data)
+/**
+ * Submit the collected steps and wait for the LCD to finish processing the last byte.
+ * @param driver The driver structure.
+ * @param batch The collected steps, or NULL if there are none.
+ * @return Non-zero if unsuccessful.
+ * @remarks In write only mode the wait is the hold time of the last transfer.
+ */
+static int lcdWaitReady(lcdDriver_t *driver, lcdBatch_t *batch)
 {
-    // Write data into bus.
+    // In write only mode an open operation carries on right after the wait.
+    if (batch && lcdBatchSubmit(driver, batch, driver->batchOpen && driver->writeOnly))
+        return -1;
+
+    if (driver->writeOnly)
+    {
+        // The hold time was part of the transfer in write only mode.
+        return 0;
+    }
+
+    // Setup read from busy flag.
     if (
-        lcdBusIO(driver, 0, 1, 0, data) < 0                     ||
-        lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-        lcdBusIO(driver, 0, 1, 1, data) < 0                     ||
-        lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-        lcdBusIO(driver, 0, 1, 0, data) < 0                     ||
-        lcdDelay(driver, driver->busTiming.dataHold)
+        lcdPins(driver, 1, 0, 0, 0) < 0                         ||
+        lcdSleep(driver, driver->busTiming.addressSetup) != 0
     )
     {
         // IO failed.
@@ -128,18 +402,16 @@ int lcdWrite(lcdDriver_t *driver, uint8_t data)
         return -1;
     }
 
-    if (driver->fourBits)
+    for (;;)
     {
-        // Write bottom nibble of data into bus if in 4bit mode.
-        data <<= 4;
-        if (
-            lcdBusIO(driver, 0, 1, 0, data) < 0                  ||
-            lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-            lcdBusIO(driver, 0, 1, 1, data) < 0                  ||
-            lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-            lcdBusIO(driver, 0, 1, 0, data) < 0                  ||
-            lcdDelay(driver, driver->busTiming.dataHold)
-        )
+        int status = lcdReceive(driver, 0);
+        LCD_STAT(driver->stats.busyPolls++);
+        if (status < 0)
+            return -1;
+        if (!(status & (1 << 7)))   // Busy flag is the 7th bit.
+            break;
+
+        if (lcdSleep(driver, driver->busTiming.busyInterval) != 0)
         {
             // IO failed.
             driver->error = EIO;
@@ -147,119 +419,659 @@ int lcdWrite(lcdDriver_t *driver, uint8_t data)
         }
     }
 
-    if (driver->writeOnly)
+    if (lcdPins(driver, 0, 0, 0, 0) < 0)
+    {
+        // IO failed.
+        driver->error = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Send a command or data byte on the bus and wait for the LCD to process it.
+ * @param driver The driver structure.
+ * @param rs Register select, false for commands and true for data.
+ * @param value The byte to send.
+ * @param hold Time the LCD takes to process the byte, in write only mode.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdSend(lcdDriver_t *driver, bool rs, uint8_t value, uint32_t hold)
+{
+    lcdBatch_t batch;
+    batch.count = 0;
+
+    return lcdTransfer(driver, &batch, rs, value, driver->writeOnly ? hold : 0) || lcdWaitReady(driver, &batch);
+}
+
+/**
+ * Step a display RAM address the way the LCD address counter does.
+ * @param driver The driver structure.
+ * @param address The display RAM address.
+ * @param forward True to step forward.
+ * @return The address after one read, write or cursor move.
+ */
+static uint8_t lcdAddressStep(lcdDriver_t *driver, uint8_t address, bool forward)
+{
+    if (driver->twoLines)
     {
-        // Just do a dumb delay if in write only mode.
-        return lcdDelay(driver, driver->busTiming.busyHoldShort);
+        // Two line mode, the lines are 0x00-0x27 and 0x40-0x67 and wrap into each other.
+        if (forward)
+            return (address == 0x27) ? 0x40 : (address == 0x67) ? 0x00 : address + 1;
+        else
+            return (address == 0x40) ? 0x27 : (address == 0x00) ? 0x67 : address - 1;
     }
     else
     {
-        // Setup read from busy flag.
-        if (
-            lcdBusIO(driver, 1, 0, 0, 0) < 0                        ||
-            lcdDelay(driver, driver->busTiming.addressSetup) != 0
-        )
+        // One line mode, the line is 0x00-0x4F.
+        if (forward)
+            return (address == 0x4F) ? 0x00 : address + 1;
+        else
+            return (address == 0x00) ? 0x4F : address - 1;
+    }
+}
+
+/**
+ * Mirror a data byte written at the tracked address in the shadow display RAM.
+ * @param driver The driver structure.
+ * @param data The byte written.
+ */
+static void lcdShadowWritten(lcdDriver_t *driver, uint8_t data)
+{
+    // Unknown addresses and character RAM are not mirrored, nor the part of
+    // the one line mode display RAM the layouts leave out.
+    if (!driver->addressValid || (!driver->twoLines && (driver->address & 0x3F) >= LCD_DDRAM_LINE))
+        return;
+
+    uint8_t index = LCD_DDRAM_INDEX(driver->address);
+    driver->shadow.ram[index] = data;
+    driver->shadow.shown[index] = data;
+}
+
+int lcdCommand(lcdDriver_t *driver, uint8_t command)
+{
+    uint64_t start = lcdStatsBegin(driver);
+
+    LCD_STAT(driver->stats.commands++);
+    if (lcdSend(driver, 0, command, driver->busTiming.execute[LCD_CMD_CLASS(command)]))
+    {
+        driver->addressValid = false;
+        return lcdStatsEnd(driver, start, -1);
+    }
+
+    // Follow the address counter.
+    if (command & 0x80)
+    {
+        driver->address = command & 0x7F;
+        driver->addressValid = true;
+    }
+    else if (command & 0x40)
+    {
+        // Address counter points into character RAM now.
+        driver->addressValid = false;
+    }
+    else if ((command & 0xF8) == LCD_CMD_CURSOR(0, 0))
+    {
+        // Cursor moves step the address counter, display shifts leave it.
+        driver->address = lcdAddressStep(driver, driver->address, command & 0x04);
+    }
+    else if ((command & 0xFC) == LCD_CMD_ENTRY(0, 0))
+    {
+        driver->direction = !!(command & 0x02);
+    }
+    else if (command == LCD_CMD_CLEAR() || (command & 0xFE) == LCD_CMD_HOME())
+    {
+        // Clear also sets the entry direction to forward, and fills the display
+        // RAM with spaces, mirror that in the shadow.
+        if (command == LCD_CMD_CLEAR())
+        {
+            driver->direction = true;
+            memset(driver->shadow.ram, ' ', sizeof(driver->shadow.ram));
+            memset(driver->shadow.shown, ' ', sizeof(driver->shadow.shown));
+        }
+        driver->address = 0;
+        driver->addressValid = true;
+    }
+
+    return lcdStatsEnd(driver, start, 0);
+}
+
+int lcdReadStatus(lcdDriver_t *driver)
+{
+    assert(driver);
+    assert(!driver->writeOnly);
+
+    uint64_t start = lcdStatsBegin(driver);
+    int status;
+    if (
+        lcdPins(driver, 1, 0, 0, 0) < 0                         ||
+        lcdSleep(driver, driver->busTiming.addressSetup) != 0
+    )
+    {
+        // IO failed.
+        driver->error = EIO;
+        return lcdStatsEnd(driver, start, -1);
+    }
+
+    if ((status = lcdReceive(driver, 0)) < 0)
+        return lcdStatsEnd(driver, start, -1);
+
+    if (lcdPins(driver, 0, 0, 0, 0) < 0)
+    {
+        // IO failed.
+        driver->error = EIO;
+        return lcdStatsEnd(driver, start, -1);
+    }
+
+    return lcdStatsEnd(driver, start, status);
+}
+
+int lcdWrite(lcdDriver_t *driver, uint8_t data)
+{
+    uint64_t start = lcdStatsBegin(driver);
+
+    LCD_STAT(driver->stats.writes++);
+    if (lcdSend(driver, 1, data, driver->busTiming.dataWrite))
+    {
+        driver->addressValid = false;
+        return lcdStatsEnd(driver, start, -1);
+    }
+
+    lcdShadowWritten(driver, data);
+    if (driver->addressValid)
+        driver->address = lcdAddressStep(driver, driver->address, driver->direction);
+
+    return lcdStatsEnd(driver, start, 0);
+}
+
+int lcdWriteBuffer(lcdDriver_t *driver, const uint8_t *data, size_t length)
+{
+    assert(driver);
+    assert(data || length == 0);
+
+    uint64_t start = lcdStatsBegin(driver);
+    lcdBatch_t batch;
+    batch.count = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        // Bytes inside the burst only wait for the data write time, the busy
+        // flag is checked once after the last byte.
+        uint32_t hold = (i + 1 < length || driver->writeOnly) ? driver->busTiming.dataWrite : 0;
+
+        LCD_STAT(driver->stats.writes++);
+        if (lcdTransfer(driver, &batch, 1, data[i], hold))
+        {
+            driver->addressValid = false;
+            return lcdStatsEnd(driver, start, -1);
+        }
+
+        lcdShadowWritten(driver, data[i]);
+        if (driver->addressValid)
+            driver->address = lcdAddressStep(driver, driver->address, driver->direction);
+    }
+
+    if (lcdWaitReady(driver, &batch))
+    {
+        driver->addressValid = false;
+        return lcdStatsEnd(driver, start, -1);
+    }
+
+    return lcdStatsEnd(driver, start, 0);
+}
+
+int lcdReadBuffer(lcdDriver_t *driver, uint8_t *data, size_t length)
+{
+    assert(driver);
+    assert(!driver->writeOnly);
+    assert(data || length == 0);
+
+    // Setup read from data register.
+    uint64_t start = lcdStatsBegin(driver);
+    if (
+        lcdPins(driver, 1, 1, 0, 0) < 0                         ||
+        lcdSleep(driver, driver->busTiming.addressSetup) != 0
+    )
+    {
+        // IO failed.
+        driver->error = EIO;
+        driver->addressValid = false;
+        return lcdStatsEnd(driver, start, -1);
+    }
+
+    for (size_t i = 0; i < length; i++)
+    {
+        // Bytes inside the burst are spaced by the data write time, the busy
+        // flag is checked once after the last byte.
+        int value = lcdReceive(driver, 1);
+        LCD_STAT(driver->stats.reads++);
+        if (value < 0 || ((i + 1 < length) && lcdSleep(driver, driver->busTiming.dataWrite) != 0))
         {
-            // IO failed.
             driver->error = EIO;
+            driver->addressValid = false;
+            return lcdStatsEnd(driver, start, -1);
+        }
+        data[i] = value;
+
+        if (driver->addressValid)
+            driver->address = lcdAddressStep(driver, driver->address, driver->direction);
+    }
+
+    return lcdStatsEnd(driver, start, lcdWaitReady(driver, NULL) ? -1 : 0);
+}
+
+int lcdRead(lcdDriver_t *driver, uint8_t *data)
+{
+    return lcdReadBuffer(driver, data, 1);
+}
+
+/**
+ * Load the shadow display RAM, without locking.
+ * @see int lcdShadowRead(lcdDriver_t*)
+ */
+static int lcdShadowLoad(lcdDriver_t *driver)
+{
+    assert(driver);
+
+    // In two line mode the address counter continues from the first line to
+    // the second, so the whole shadow is read in one go.
+    uint8_t length = driver->twoLines ? LCD_DDRAM_SIZE : LCD_DDRAM_LINE;
+    uint8_t last = driver->twoLines ? 0x40 + LCD_DDRAM_LINE - 1 : LCD_DDRAM_LINE - 1;
+
+    // Always set the address, a read right after a write returns stale data.
+    if (
+        lcdCommand(driver, LCD_CMD_DADDR(driver->direction ? 0x00 : last))  ||
+        lcdReadBuffer(driver, driver->shadow.shown, length)
+    )
+    {
+        return -1;
+    }
+
+    if (!driver->direction)
+    {
+        // Read backwards, reverse into display RAM order.
+        for (uint8_t i = 0; i < length / 2; i++)
+        {
+            uint8_t value = driver->shadow.shown[i];
+            driver->shadow.shown[i] = driver->shadow.shown[length - 1 - i];
+            driver->shadow.shown[length - 1 - i] = value;
+        }
+    }
+
+    memcpy(driver->shadow.ram, driver->shadow.shown, length);
+    return 0;
+}
+
+int lcdShadowRead(lcdDriver_t *driver)
+{
+    assert(driver);
+    lcdLock(driver);
+    int result = lcdShadowLoad(driver);
+    lcdUnlock(driver);
+    return result;
+}
+
+/**
+ * Send a run of the shadow display RAM to the LCD.
+ * @param driver The driver structure.
+ * @param first Index of the first byte in the run.
+ * @param last Index of the last byte in the run.
+ * @return Non-zero if unsuccessful.
+ * @remarks Clean bytes inside the run are sent again, they hold the same value
+ * as the display RAM.
+ */
+static int lcdFlushRun(lcdDriver_t *driver, uint8_t first, uint8_t last)
+{
+    // The address counter follows the entry direction, so write backwards from
+    // the last byte if the direction is reversed.
+    uint8_t start = driver->direction ? first : last;
+    uint8_t address = (start >= LCD_DDRAM_LINE) ? 0x40 + start - LCD_DDRAM_LINE : start;
+
+    if (lcdSeek(driver, address))
+        return -1;
+
+    // The writes mark the cells as shown.
+    if (driver->direction)
+        return lcdWriteBuffer(driver, &driver->shadow.ram[first], last - first + 1);
+
+    for (int i = 0; i <= last - first; i++)
+    {
+        if (lcdWrite(driver, driver->shadow.ram[last - i]))
             return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Estimate the time spent on the bus for one command or data byte.
+ * @param driver The driver structure.
+ * @param hold Time the LCD takes to process the byte.
+ * @param burst The byte is inside a burst, which is spaced by the hold without polling.
+ * @return Estimated time in microseconds.
+ */
+static uint32_t lcdByteCost(lcdDriver_t *driver, uint32_t hold, bool burst)
+{
+    uint32_t strobe = driver->busTiming.addressSetup + driver->busTiming.enableHold + driver->busTiming.dataHold;
+    uint32_t transfer = driver->fourBits ? 2 * strobe : strobe;
+
+    if (driver->writeOnly || burst)
+        return transfer + hold;
+    else
+        return transfer + hold + driver->busTiming.addressSetup + transfer;  // At least one busy flag read.
+}
+
+/**
+ * Send the changed parts of the shadow display RAM, without locking.
+ * @see int lcdFlush(lcdDriver_t*)
+ */
+static int lcdFlushShadow(lcdDriver_t *driver)
+{
+    assert(driver);
+
+    // Rewriting the clean bytes between two runs is cheaper than an address
+    // set when the gap is short enough.
+    uint32_t byteCost = lcdByteCost(driver, driver->busTiming.dataWrite, true);
+    uint32_t jumpCost = lcdByteCost(driver, driver->busTiming.execute[LCD_CMD_CLASS(LCD_CMD_DADDR(0))], false);
+
+    int first = -1;
+    int last = -1;
+    for (int index = 0; index <= LCD_DDRAM_SIZE; index++)
+    {
+        bool dirty = index < LCD_DDRAM_SIZE && driver->shadow.ram[index] != driver->shadow.shown[index];
+
+        // In one line mode, runs end at the end of the line because the address
+        // counter does not continue into the second half of the shadow.
+        if (first >= 0 && ((index == LCD_DDRAM_LINE && !driver->twoLines) || index == LCD_DDRAM_SIZE))
+        {
+            if (lcdFlushRun(driver, first, last))
+                return -1;
+            first = -1;
         }
 
-        int value = 0;
-        do {
-            if (
-                lcdDelay(driver, driver->busTiming.busyInterval) != 0   ||  // Delay before reading busy pin.
-                lcdBusIO(driver, 1, 0, 1, 0) < 0                        ||
-                lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-                (value = lcdBusIO(driver, 1, 0, 1, 0)) < 0              ||  // Read busy value.
-                lcdBusIO(driver, 1, 0, 0, 0) < 0                        ||
-                ((driver->fourBits) && (                                    // 4-bit mode extra ticks.
-                    lcdDelay(driver, driver->busTiming.dataHold) != 0   ||
-                    lcdBusIO(driver, 1, 0, 1, 0) < 0                    ||
-                    lcdDelay(driver, driver->busTiming.enableHold)      ||
-                    lcdBusIO(driver, 1, 0, 0, 0) < 0
-                ))
-            )
-            {
-                // IO failed.
-                driver->error = EIO;
+        if (!dirty)
+            continue;
+
+        if (first >= 0 && (uint32_t)(index - last - 1) * byteCost > jumpCost)
+        {
+            if (lcdFlushRun(driver, first, last))
                 return -1;
-            }
-        } while (value & (1 << 7)); // Busy flag is the 7th bit.
+            first = -1;
+        }
 
-        return lcdBusIO(driver, 0, 0, 0, 0);
+        if (first < 0)
+            first = index;
+        last = index;
     }
+
+    return 0;
 }
 
-int lcdInit4Bit(lcdDriver_t *driver)
+int lcdFlush(lcdDriver_t *driver)
+{
+    assert(driver);
+    lcdLock(driver);
+
+    // The runs and their address sets go to the batch handler as one sequence.
+    driver->batchOpen = true;
+    int result = lcdFlushShadow(driver);
+    driver->batchOpen = false;
+    if (lcdBatchClose(driver))
+        result = -1;
+
+    lcdUnlock(driver);
+    return result;
+}
+
+/**
+ * Put the LCD into a known state with the 8 bit function set sequence.
+ * @param driver The driver structure.
+ * @return Non-zero if unsuccessful.
+ * @remarks Works from any bus width the LCD may be in, only the upper four
+ * data lines are significant.
+ */
+static int lcdInitReset(lcdDriver_t *driver)
 {
     uint8_t cmd = LCD_CMD_FUNCTION(1, 0, 0);
 
     // Do operations on the bus as if the display is in 8 bit mode.
     if (
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-        lcdBusIO(driver, 0, 0, 1, cmd) < 0                      || // Set 8 bit mode.
-        lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      ||
-        lcdDelay(driver, 5000) != 0                             || // Sleep for 5ms. (from hitachi manual)
-
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-        lcdBusIO(driver, 0, 0, 1, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      || // Set 8 bit mode again.
-        lcdDelay(driver, 100) != 0                              || // Sleep for 100 uS (from hitachi manual)
-
-        lcdBusIO(driver, 0, 0, 1, cmd) < 0                      || // Set 8 bit mode once again.
-        lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.dataHold) != 0
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.addressSetup) != 0   ||
+        lcdPins(driver, 0, 0, 1, cmd) < 0                       || // Set 8 bit mode.
+        lcdSleep(driver, driver->busTiming.enableHold) != 0     ||
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       ||
+        lcdSleep(driver, 5000) != 0                             || // Sleep for 5ms. (from hitachi manual)
+
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.addressSetup) != 0   ||
+        lcdPins(driver, 0, 0, 1, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.enableHold) != 0     ||
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       || // Set 8 bit mode again.
+        lcdSleep(driver, 100) != 0                              || // Sleep for 100 uS (from hitachi manual)
+
+        lcdPins(driver, 0, 0, 1, cmd) < 0                       || // Set 8 bit mode once again.
+        lcdSleep(driver, driver->busTiming.enableHold) != 0     ||
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.dataHold + driver->busTiming.execute[LCD_CMD_CLASS(cmd)]) != 0
     )
     {
         driver->error = EIO;
+        LCD_STAT(driver->stats.errors++);
         return -1;
     }
 
-    cmd = LCD_CMD_FUNCTION(0, 0, 0);
+    return 0;
+}
+
+int lcdInit4Bit(lcdDriver_t *driver)
+{
+    if (lcdInitReset(driver))
+        return -1;
+
+    uint8_t cmd = LCD_CMD_FUNCTION(0, 0, 0);
 
     if (
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.addressSetup) != 0   ||
-        lcdBusIO(driver, 0, 0, 1, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.enableHold) != 0     ||
-        lcdBusIO(driver, 0, 0, 0, cmd) < 0                      ||
-        lcdDelay(driver, driver->busTiming.dataHold + 100) != 0    // Request four bit mode, still in 8 bit mode.
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.addressSetup) != 0   ||
+        lcdPins(driver, 0, 0, 1, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.enableHold) != 0     ||
+        lcdPins(driver, 0, 0, 0, cmd) < 0                       ||
+        lcdSleep(driver, driver->busTiming.dataHold + 100) != 0    // Request four bit mode, still in 8 bit mode.
     )
     {
         driver->error = EIO;
+        LCD_STAT(driver->stats.errors++);
         return -1;
     }
 
-    return lcdCommand(driver, cmd);                // Final request for four bit mode, LCD is initialized.
+    return 0;                                       // LCD is in four bit mode, function set follows.
 }
 
-int lcdInit(lcdDriver_t *driver)
+int lcdInit8Bit(lcdDriver_t *driver)
+{
+    return lcdInitReset(driver);                    // LCD is in eight bit mode, function set follows.
+}
+
+/**
+ * Pick up the time from the poll call.
+ * @param driver The driver structure.
+ * @param now Current time in microseconds.
+ */
+static void lcdPollClock(lcdDriver_t *driver, uint64_t now)
+{
+    // The last step was executed by a blocking call, its delay starts now.
+    if (!driver->poll.known)
+    {
+        driver->poll.due = now + driver->poll.hold;
+        driver->poll.known = true;
+    }
+}
+
+/**
+ * Execute the queued bus steps that are due, without locking.
+ * @see int64_t lcdPoll(lcdDriver_t*,uint64_t)
+ */
+static int64_t lcdPollDue(lcdDriver_t *driver, uint64_t now)
+{
+    assert(driver);
+    assert(driver->queue);
+
+    lcdPollClock(driver, now);
+    while (driver->poll.count && now >= driver->poll.due)
+    {
+        uint64_t start = lcdStatsBegin(driver);
+        if (lcdStep(driver))
+            return lcdStatsEnd(driver, start, -1);
+        driver->poll.due = now + driver->poll.hold;
+    }
+
+    return driver->poll.count ? (int64_t)driver->poll.due : LCD_POLL_IDLE;
+}
+
+int64_t lcdPoll(lcdDriver_t *driver, uint64_t now)
+{
+    assert(driver);
+    lcdLock(driver);
+    int64_t result = lcdPollDue(driver, now);
+    lcdUnlock(driver);
+    return result;
+}
+
+int64_t lcdPollNext(lcdDriver_t *driver, uint64_t now)
+{
+    assert(driver);
+    assert(driver->queue);
+
+    lcdLock(driver);
+    lcdPollClock(driver, now);
+    int64_t result = driver->poll.count ? (int64_t)driver->poll.due : LCD_POLL_IDLE;
+    lcdUnlock(driver);
+    return result;
+}
+
+int lcdPollStep(lcdDriver_t *driver, uint64_t now, lcdBusStep_t *step)
+{
+    assert(driver);
+    assert(driver->queue);
+    assert(driver->poll.count);
+
+    lcdLock(driver);
+    lcdPollClock(driver, now);
+    if (step)
+        *step = driver->queue[driver->poll.head];
+    uint64_t start = lcdStatsBegin(driver);
+    int result = lcdStatsEnd(driver, start, lcdStep(driver));
+    driver->poll.due = now + driver->poll.hold;
+    lcdUnlock(driver);
+    return result;
+}
+
+/**
+ * Execute all queued bus steps, without locking.
+ * @see int lcdSync(lcdDriver_t*)
+ */
+static int lcdSyncQueue(lcdDriver_t *driver)
+{
+    assert(driver);
+    assert(driver->queue);
+
+    while (driver->poll.count)
+    {
+        uint64_t start = lcdStatsBegin(driver);
+        if (lcdStepHold(driver) || lcdStep(driver))
+            return lcdStatsEnd(driver, start, -1);
+    }
+
+    return lcdStepHold(driver);
+}
+
+int lcdSync(lcdDriver_t *driver)
 {
     assert(driver);
+    lcdLock(driver);
+    int result = lcdSyncQueue(driver);
+    lcdUnlock(driver);
+    return result;
+}
+
+/**
+ * Fill the display RAM layout from the geometry.
+ * @param driver The driver structure.
+ */
+static void lcdLayoutInit(lcdDriver_t *driver)
+{
+    uint8_t width = driver->dimensions.width;
+
+    switch (driver->geometry)
+    {
+    case LCD_GEOMETRY_STANDARD:
+    case LCD_GEOMETRY_WIDE:
+    {
+        uint8_t offset = (driver->geometry == LCD_GEOMETRY_WIDE) ? 0x14 : width;
+        driver->layout.rowBase[0] = 0x00;
+        driver->layout.rowBase[1] = 0x40;
+        driver->layout.rowBase[2] = offset;
+        driver->layout.rowBase[3] = 0x40 + offset;
+        driver->layout.split = width;
+        break;
+    }
+    case LCD_GEOMETRY_SPLIT:
+        assert(driver->dimensions.height == 1);
+        memset(driver->layout.rowBase, 0, sizeof(driver->layout.rowBase));
+        driver->layout.split = width / 2;
+        break;
+    case LCD_GEOMETRY_CUSTOM:
+        break;
+    }
+
+    // The second line only exists in two line mode.
+    driver->twoLines = driver->layout.split < width;
+    for (uint8_t row = 0; row < driver->dimensions.height; row++)
+        driver->twoLines |= (driver->layout.rowBase[row] & 0x40) != 0;
+}
+
+/**
+ * Initialize the LCD, without locking.
+ * @see int lcdInit(lcdDriver_t*)
+ */
+static int lcdInitDriver(lcdDriver_t *driver)
+{
+    assert(driver);
+
+    // Start over, the reset sequence brings the LCD back from any half sent byte.
+    if (driver->queue)
+    {
+        driver->poll.count = 0;
+        if (lcdStepHold(driver))
+            return -1;
+    }
+
     driver->cursor.x = 0;
     driver->cursor.y = 0;
+    driver->addressValid = false;
+    lcdLayoutInit(driver);
 
     if (
-        driver->fourBits &&
-        (
-            lcdInit4Bit(driver) ||
-            lcdCommand(driver, LCD_CMD_FUNCTION(0, driver->dimensions.height > 1, driver->largeFont)) ||
-            lcdDelay(driver, driver->busTiming.busyHoldShort)
-        )
+        (driver->fourBits ? lcdInit4Bit(driver) : lcdInit8Bit(driver)) ||
+        lcdCommand(driver, LCD_CMD_FUNCTION(!driver->fourBits, driver->twoLines, driver->largeFont))
     )
     {
         return -1;
     }
-    else if (!driver->fourBits)
-    {
-        assert(false);
-    }
 
-    return lcdClear(driver);
+    if (lcdCommand(driver, LCD_CMD_CLEAR()))
+        return -1;
+
+    return 0;
+}
+
+int lcdInit(lcdDriver_t *driver)
+{
+    assert(driver);
+    lcdLock(driver);
+    int result = lcdInitDriver(driver);
+    lcdUnlock(driver);
+    return result;
 }
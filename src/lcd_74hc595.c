@@ -0,0 +1,42 @@
+#include "lcd_74hc595.h"
+
+/**
+ * Expander transmit handler, one SPI transfer per call.
+ */
+static int lcd74hc595Transmit(lcdExpander_t *expander, const uint8_t *data, size_t length)
+{
+    lcd74hc595_t *shifter = (lcd74hc595_t*)expander;
+    return shifter->write(shifter->bus, data, length);
+}
+
+void lcd74hc595Init(lcd74hc595_t *shifter, uint32_t clock, uint16_t maxLength, lcdSpiWriteHandler_t write, void *bus)
+{
+    assert(shifter);
+    assert(clock);
+    assert(maxLength > 0 && maxLength <= LCD_EXPANDER_BUFFER);
+    assert(write);
+
+    memset(shifter, 0, sizeof(*shifter));
+    shifter->expander.pins = (lcdExpanderPins_t)LCD_74HC595_PINS;
+    shifter->expander.backlight = true;
+    shifter->expander.byteTime = (uint32_t)((8ull * 1000000000) / clock);
+    shifter->expander.leadBytes = 1;
+    // The SPI bus is not shared, waiting by padding costs nothing.
+    shifter->expander.maxPadding = (maxLength > UINT8_MAX) ? UINT8_MAX : maxLength;
+    shifter->expander.maxLength = maxLength;
+    shifter->expander.transmit = lcd74hc595Transmit;
+    shifter->write = write;
+    shifter->bus = bus;
+}
+
+void lcd74hc595Attach(lcd74hc595_t *shifter, lcdDriver_t *driver)
+{
+    assert(shifter);
+    assert(driver);
+    assert(driver->fourBits);
+    assert(driver->writeOnly);
+
+    driver->userData = shifter;
+    driver->busIO = lcdExpanderBusIO;
+    driver->batch = lcdExpanderBatch;
+}
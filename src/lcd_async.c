@@ -0,0 +1,251 @@
+#include "lcd_async.h"
+
+/** Most data bytes handed to lcdWriteBuffer at once. */
+#define LCD_ASYNC_BURST 40
+
+/**
+ * Reserve consecutive ring positions.
+ * @param async The display task structure.
+ * @param count Number of positions.
+ * @param position The first reserved position.
+ * @return Non-zero if the ring does not have room.
+ */
+static int lcdAsyncReserve(lcdAsync_t *async, uint32_t count, uint32_t *position)
+{
+    uint32_t tail = atomic_load_explicit(&async->tail, memory_order_relaxed);
+    do
+    {
+        uint32_t head = atomic_load_explicit(&async->head, memory_order_acquire);
+        if (tail - head + count > async->size)
+            return -1;
+    }
+    while (!atomic_compare_exchange_weak_explicit(&async->tail, &tail, tail + count, memory_order_relaxed, memory_order_relaxed));
+
+    *position = tail;
+    return 0;
+}
+
+/**
+ * Fill a reserved position and hand it to the display task.
+ * @param async The display task structure.
+ * @param position The position.
+ * @param op The operation.
+ */
+static void lcdAsyncPublish(lcdAsync_t *async, uint32_t position, uint16_t op)
+{
+    lcdAsyncSlot_t *slot = &async->slots[position & (async->size - 1)];
+    slot->op = op;
+    atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+}
+
+/**
+ * Wake the display task.
+ * @param async The display task structure.
+ */
+static void lcdAsyncWake(lcdAsync_t *async)
+{
+#ifdef ESP_PLATFORM
+    xTaskNotifyGive(async->task);
+#else
+    sem_post(&async->wake);
+#endif
+}
+
+/**
+ * Take the next operation, if it has been published.
+ * @param async The display task structure.
+ * @param op The operation.
+ * @return True if there was one.
+ */
+static bool lcdAsyncPop(lcdAsync_t *async, uint16_t *op)
+{
+    uint32_t head = atomic_load_explicit(&async->head, memory_order_relaxed);
+    lcdAsyncSlot_t *slot = &async->slots[head & (async->size - 1)];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != head + 1)
+        return false;
+
+    *op = slot->op;
+    atomic_store_explicit(&async->head, head + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Execute everything published so far.
+ * @param async The display task structure.
+ */
+static void lcdAsyncDrain(lcdAsync_t *async)
+{
+    uint8_t burst[LCD_ASYNC_BURST];
+    size_t length = 0;
+    uint16_t op;
+    bool more;
+
+    do
+    {
+        more = lcdAsyncPop(async, &op);
+
+        // Consecutive data bytes go out as one write.
+        if (more && (op & LCD_ASYNC_DATA) && length < LCD_ASYNC_BURST)
+        {
+            burst[length++] = op & 0xFF;
+            continue;
+        }
+        if (length && lcdWriteBuffer(async->driver, burst, length))
+            atomic_fetch_add(&async->errors, 1);
+        length = 0;
+
+        if (more && (op & LCD_ASYNC_DATA))
+            burst[length++] = op & 0xFF;
+        else if (more && lcdCommand(async->driver, op & 0xFF))
+            atomic_fetch_add(&async->errors, 1);
+    }
+    while (more);
+}
+
+/**
+ * Display task body, drains the ring whenever woken until stopped.
+ * @param async The display task structure.
+ */
+static void lcdAsyncRun(lcdAsync_t *async)
+{
+    while (atomic_load(&async->running))
+    {
+#ifdef ESP_PLATFORM
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#else
+        sem_wait(&async->wake);
+#endif
+        lcdAsyncDrain(async);
+    }
+
+    // Leave nothing behind.
+    lcdAsyncDrain(async);
+}
+
+#ifdef ESP_PLATFORM
+static void lcdAsyncTask(void *arg)
+{
+    lcdAsync_t *async = arg;
+    lcdAsyncRun(async);
+    xSemaphoreGive(async->done);
+    vTaskDelete(NULL);
+}
+#else
+static void *lcdAsyncThread(void *arg)
+{
+    lcdAsyncRun(arg);
+    return NULL;
+}
+#endif
+
+int lcdAsyncStart(lcdAsync_t *async, lcdDriver_t *driver, lcdAsyncSlot_t *slots, uint32_t size)
+{
+    assert(async);
+    assert(driver);
+    assert(slots);
+    assert(size && !(size & (size - 1)));
+
+    async->driver = driver;
+    async->slots = slots;
+    async->size = size;
+    atomic_init(&async->errors, 0);
+    atomic_init(&async->head, 0);
+    atomic_init(&async->tail, 0);
+    atomic_init(&async->running, true);
+
+    // No slot holds position zero plus one yet.
+    for (uint32_t i = 0; i < size; i++)
+        atomic_init(&slots[i].sequence, 0);
+
+#ifdef ESP_PLATFORM
+    async->done = xSemaphoreCreateBinaryStatic(&async->doneBuffer);
+    if (xTaskCreate(lcdAsyncTask, "lcd", LCD_ASYNC_STACK, async, LCD_ASYNC_PRIORITY, &async->task) != pdPASS)
+        return -1;
+#else
+    if (sem_init(&async->wake, 0, 0))
+        return -1;
+    if (pthread_create(&async->thread, NULL, lcdAsyncThread, async))
+    {
+        sem_destroy(&async->wake);
+        return -1;
+    }
+#endif
+
+    return 0;
+}
+
+int lcdAsyncStop(lcdAsync_t *async)
+{
+    assert(async);
+
+    atomic_store(&async->running, false);
+    lcdAsyncWake(async);
+
+#ifdef ESP_PLATFORM
+    xSemaphoreTake(async->done, portMAX_DELAY);
+#else
+    if (pthread_join(async->thread, NULL))
+        return -1;
+    sem_destroy(&async->wake);
+#endif
+
+    return 0;
+}
+
+int lcdAsyncPush(lcdAsync_t *async, const uint16_t *ops, size_t count)
+{
+    assert(async);
+    assert(ops || count == 0);
+
+    uint32_t position;
+    if (count == 0)
+        return 0;
+    if (count > async->size || lcdAsyncReserve(async, count, &position))
+        return -1;
+
+    for (size_t i = 0; i < count; i++)
+        lcdAsyncPublish(async, position + i, ops[i]);
+
+    lcdAsyncWake(async);
+    return 0;
+}
+
+int lcdAsyncPutString(lcdAsync_t *async, int8_t x, int8_t y, const char *str, size_t length)
+{
+    assert(async);
+    assert(str || length == 0);
+
+    const lcdDriver_t *driver = async->driver;
+    uint8_t width = driver->dimensions.width;
+    uint8_t height = driver->dimensions.height;
+    assert(x >= 0 && x < width && y >= 0 && y < height);
+
+    // An address command for every row the string touches, and every split
+    // it crosses.
+    uint8_t split = driver->layout.split;
+    size_t jumps = 0;
+    for (size_t i = 0, column = x; i < length; i++, column = (column + 1) % width)
+        jumps += (i == 0 || column == 0 || column == split);
+
+    uint32_t position;
+    if (length == 0)
+        return 0;
+    if (length + jumps > async->size || lcdAsyncReserve(async, length + jumps, &position))
+        return -1;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (i == 0 || x == 0 || x == split)
+            lcdAsyncPublish(async, position++, LCD_CMD_DADDR(LCD_DECODE_POSITION(driver, x, y)));
+        lcdAsyncPublish(async, position++, LCD_ASYNC_DATA | (uint8_t)str[i]);
+
+        if (++x == width)
+        {
+            x = 0;
+            y = (y + 1) % height;
+        }
+    }
+
+    lcdAsyncWake(async);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "lcd_dual.h"
+
+int lcdDualInit(lcdDual_t *dual, uint8_t width)
+{
+    assert(dual);
+
+    dual->active = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        lcdDriver_t *half = &dual->halves[i];
+        half->dimensions.width = width;
+        half->dimensions.height = 2;
+        half->buffered = true;
+        half->queue = NULL;
+        dual->drivers[i] = half;
+
+        if (lcdInit(half))
+            return -1;
+    }
+
+    return 0;
+}
+
+int lcdDualSetDisplay(lcdDual_t *dual, bool display, bool cursor, bool blink)
+{
+    assert(dual);
+
+    // Only the active half shows the cursor.
+    return (
+        lcdSetDisplay(&dual->halves[0], display, cursor && dual->active == 0, blink && dual->active == 0) ||
+        lcdSetDisplay(&dual->halves[1], display, cursor && dual->active == 1, blink && dual->active == 1)
+    ) ? -1 : 0;
+}
+
+int lcdDualStoreGlyph(lcdDual_t *dual, char which, const uint8_t *bits)
+{
+    assert(dual);
+    return (lcdStoreGlyph(&dual->halves[0], which, bits) || lcdStoreGlyph(&dual->halves[1], which, bits)) ? -1 : 0;
+}
+
+int lcdDualClear(lcdDual_t *dual)
+{
+    assert(dual);
+
+    dual->active = 0;
+    return (lcdClear(&dual->halves[0]) || lcdClear(&dual->halves[1])) ? -1 : 0;
+}
+
+int lcdDualSetCursor(lcdDual_t *dual, uint8_t column, uint8_t row)
+{
+    assert(dual);
+    assert(row < 4);
+
+    dual->active = row / 2;
+    return lcdSetCursor(&dual->halves[dual->active], column, row % 2);
+}
+
+int lcdDualPutString(lcdDual_t *dual, const char *str, size_t length)
+{
+    assert(dual);
+    assert(str);
+
+    for (size_t i = 0; i < length; i++)
+    {
+        lcdDriver_t *half = &dual->halves[dual->active];
+        if (lcdPutChar(half, str[i]))
+            return -1;
+
+        // Wrapping past the last row of a half goes on in the other half.
+        uint8_t x = half->direction ? 0 : half->dimensions.width - 1;
+        uint8_t y = half->direction ? 0 : 1;
+        if (half->cursor.x == x && half->cursor.y == y)
+        {
+            dual->active ^= 1;
+            if (lcdSetCursor(&dual->halves[dual->active], x, y))
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+int lcdDualFlush(lcdDual_t *dual)
+{
+    assert(dual);
+
+    if (!dual->halves[0].writeOnly || !dual->halves[1].writeOnly)
+        return (lcdFlush(&dual->halves[0]) || lcdFlush(&dual->halves[1])) ? -1 : 0;
+
+    // Queue both halves, then run them together. Without a clock, time only
+    // has to move forward as fast as the delays, so it is the sum of them.
+    lcdDriver_t *clock = &dual->halves[0];
+    int result = 0;
+    for (int i = 0; i < 2 && !result; i++)
+    {
+        dual->halves[i].queue = dual->queues[i];
+        dual->halves[i].queueSize = LCD_DUAL_QUEUE;
+        result = lcdFlush(&dual->halves[i]);
+    }
+
+    lcdMultiInit(&dual->multi, dual->drivers, 2);
+    uint64_t now = clock->now ? clock->now(clock) : 0;
+    while (!result)
+    {
+        int64_t next = lcdMultiPoll(&dual->multi, now);
+        if (next < 0)
+            result = -1;
+        else if (next == LCD_POLL_IDLE)
+            break;
+        else if ((uint64_t)next > now && lcdDelay(clock, next - now))
+            result = -1;
+        else
+            now = clock->now ? clock->now(clock) : (uint64_t)next;
+    }
+
+    // Wait for the last delays and go back to blocking mode.
+    for (int i = 0; i < 2; i++)
+    {
+        if (dual->halves[i].queue && lcdSync(&dual->halves[i]))
+            result = -1;
+        dual->halves[i].queue = NULL;
+    }
+
+    return result;
+}
@@ -0,0 +1,81 @@
+#include "lcd_expander.h"
+
+int lcdExpanderFlush(lcdExpander_t *expander)
+{
+    assert(expander);
+    assert(expander->transmit);
+
+    if (expander->length == 0)
+        return 0;
+
+    uint16_t length = expander->length;
+    expander->length = 0;
+    return expander->transmit(expander, expander->buffer, length) < 0 ? -1 : 0;
+}
+
+int lcdExpanderBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    lcdExpander_t *expander = driver->userData;
+    assert(expander);
+    assert(expander->transmit);
+
+    // No read back, the port is output only.
+    if (rw)
+        return -1;
+
+    uint8_t port = lcdExpanderPack(expander, rw, rs, en, data);
+    if (lcdExpanderFlush(expander) || expander->transmit(expander, &port, 1) < 0)
+        return -1;
+    expander->port = port;
+    return 0;
+}
+
+int lcdExpanderBatch(lcdDriver_t *driver, const lcdBusStep_t *steps, size_t count, bool more)
+{
+    lcdExpander_t *expander = driver->userData;
+    assert(expander);
+    assert(expander->byteTime);
+    assert(expander->maxLength > 0 && expander->maxLength <= LCD_EXPANDER_BUFFER);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t port = lcdExpanderPack(expander, steps[i].rw, steps[i].rs, steps[i].en, steps[i].data);
+
+        // The next byte takes byteTime to reach the port, repeat this one
+        // until the delay is covered.
+        uint64_t delay = (uint64_t)steps[i].delay * 1000;
+        uint32_t padding = (delay > expander->byteTime) ? (delay + expander->byteTime - 1) / expander->byteTime - 1 : 0;
+
+        // Data only has to be set up before enable falls, a step changing
+        // nothing but data ahead of a rising enable is folded into that edge
+        // along with its address set-up delay.
+        uint8_t control = (1 << expander->pins.rs) | (1 << expander->pins.rw) | (1 << expander->pins.en);
+        if (i + 1 < count && steps[i + 1].en && !steps[i].en &&
+            (port & control) == (expander->port & control))
+            continue;
+
+        if (expander->length == expander->maxLength && lcdExpanderFlush(expander))
+            return -1;
+        expander->buffer[expander->length++] = port;
+        expander->port = port;
+
+        if (padding <= expander->maxPadding && expander->length + padding <= expander->maxLength)
+        {
+            while (padding--)
+                expander->buffer[expander->length++] = port;
+        }
+        else
+        {
+            // The next transfer takes leadBytes to change the outputs, only
+            // delay the rest.
+            uint64_t lead = (uint64_t)expander->leadBytes * expander->byteTime;
+            if (lcdExpanderFlush(expander))
+                return -1;
+            if (delay > lead && lcdDelay(driver, (delay - lead + 999) / 1000))
+                return -1;
+        }
+    }
+
+    // Held bytes go out with the following steps, or once the buffer is full.
+    return more ? 0 : lcdExpanderFlush(expander);
+}
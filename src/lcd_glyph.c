@@ -0,0 +1,142 @@
+#include "lcd_glyph.h"
+
+#include <errno.h>
+
+/**
+ * Count the cells showing each slot.
+ * @param cache The glyph cache structure.
+ * @param refs Storage for the count of each slot.
+ * @remarks Cells are counted both as they are and as they will be after the
+ * next flush, a slot must not change under either.
+ */
+static void lcdGlyphRefs(lcdGlyphCache_t *cache, uint8_t refs[LCD_GLYPH_SLOTS])
+{
+    lcdDriver_t *driver = cache->driver;
+    memset(refs, 0, LCD_GLYPH_SLOTS);
+
+    for (uint8_t y = 0; y < driver->dimensions.height; y++)
+    {
+        for (uint8_t x = 0; x < driver->dimensions.width; x++)
+        {
+            uint8_t index = LCD_DDRAM_INDEX(LCD_DECODE_POSITION(driver, x, y));
+            uint8_t cells[2] = { driver->shadow.ram[index], driver->shadow.shown[index] };
+
+            // Codes 8-15 repeat 0-7, and large glyphs take two codes each.
+            for (int i = 0; i < 2; i++)
+            {
+                if (cells[i] < 16)
+                    refs[driver->largeFont ? (cells[i] & 0x06) >> 1 : cells[i] & 0x07]++;
+            }
+        }
+    }
+}
+
+/**
+ * Upload a glyph into a slot.
+ * @param cache The glyph cache structure.
+ * @param slot The slot.
+ * @param bits Rows of the glyph.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdGlyphUpload(lcdGlyphCache_t *cache, uint8_t slot, const uint8_t *bits)
+{
+    lcdDriver_t *driver = cache->driver;
+    uint8_t size = driver->largeFont ? 10 : 8;
+
+    // Large glyphs take 16 bytes of character RAM.
+    uint8_t address = slot << (driver->largeFont ? 4 : 3);
+    if (lcdCommand(driver, LCD_CMD_CADDR(address)) || lcdWriteBuffer(driver, bits, size))
+        return -1;
+
+    memcpy(cache->slots[slot].bits, bits, size);
+    return 0;
+}
+
+void lcdGlyphInit(lcdGlyphCache_t *cache, lcdDriver_t *driver)
+{
+    assert(cache);
+    assert(driver);
+    assert(driver->buffered);
+
+    memset(cache, 0, sizeof(*cache));
+    cache->driver = driver;
+}
+
+/**
+ * Get the character code of a glyph, without locking.
+ * @see int lcdGlyphGet(lcdGlyphCache_t*,uint16_t,const uint8_t*)
+ */
+static int lcdGlyphFind(lcdGlyphCache_t *cache, uint16_t id, const uint8_t *bits)
+{
+    lcdDriver_t *driver = cache->driver;
+    uint8_t count = driver->largeFont ? LCD_GLYPH_SLOTS / 2 : LCD_GLYPH_SLOTS;
+    uint8_t size = driver->largeFont ? 10 : 8;
+    int slot = -1;
+
+    for (uint8_t i = 0; i < count && slot < 0; i++)
+    {
+        if (cache->slots[i].used && cache->slots[i].id == id)
+            slot = i;
+    }
+
+    if (slot >= 0)
+    {
+        if (memcmp(cache->slots[slot].bits, bits, size) != 0 && lcdGlyphUpload(cache, slot, bits))
+            return -1;
+    }
+    else
+    {
+        // A free slot, or else the least recently used one no cell shows.
+        uint8_t refs[LCD_GLYPH_SLOTS];
+        lcdGlyphRefs(cache, refs);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (!cache->slots[i].used)
+            {
+                slot = i;
+                break;
+            }
+            if (refs[i] == 0 && (slot < 0 || cache->slots[i].lastUse < cache->slots[slot].lastUse))
+                slot = i;
+        }
+
+        if (slot < 0)
+        {
+            driver->error = ENOSPC;
+            return -1;
+        }
+
+        cache->slots[slot].used = false;
+        if (lcdGlyphUpload(cache, slot, bits))
+            return -1;
+        cache->slots[slot].used = true;
+        cache->slots[slot].id = id;
+    }
+
+    cache->slots[slot].lastUse = ++cache->uses;
+    return 8 + (driver->largeFont ? slot << 1 : slot);
+}
+
+int lcdGlyphGet(lcdGlyphCache_t *cache, uint16_t id, const uint8_t *bits)
+{
+    assert(cache);
+    assert(bits);
+
+    lcdLock(cache->driver);
+    int result = lcdGlyphFind(cache, id, bits);
+    lcdUnlock(cache->driver);
+    return result;
+}
+
+int lcdGlyphPut(lcdGlyphCache_t *cache, uint16_t id, const uint8_t *bits)
+{
+    assert(cache);
+    assert(bits);
+
+    lcdLock(cache->driver);
+    int code = lcdGlyphFind(cache, id, bits);
+    if (code >= 0)
+        lcdShadowPut(cache->driver, (char)code);
+    lcdUnlock(cache->driver);
+    return code < 0 ? -1 : 0;
+}
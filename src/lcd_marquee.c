@@ -0,0 +1,137 @@
+#include "lcd_marquee.h"
+
+/**
+ * Number of columns in a display RAM line, the length the display shift goes round.
+ * @param driver The driver structure.
+ * @return The number of columns.
+ */
+static uint8_t lcdMarqueeRing(const lcdDriver_t *driver)
+{
+    return driver->twoLines ? LCD_DDRAM_LINE : LCD_DDRAM_SIZE;
+}
+
+/**
+ * Write a run of a display RAM line, mirrored in the shadow so a flush does not undo it.
+ * @param driver The driver structure.
+ * @param address Display RAM address of the first byte.
+ * @param data The bytes.
+ * @param length Number of bytes.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdMarqueeWrite(lcdDriver_t *driver, uint8_t address, const uint8_t *data, size_t length)
+{
+    if (length == 0)
+        return 0;
+    if (lcdSeek(driver, address) || lcdWriteBuffer(driver, data, length))
+        return -1;
+
+    // In one line mode the shadow only covers the first 40 columns.
+    for (size_t i = 0; i < length; i++)
+    {
+        uint8_t cell = address + i;
+        if (driver->twoLines || cell < LCD_DDRAM_LINE)
+        {
+            driver->shadow.ram[LCD_DDRAM_INDEX(cell)] = data[i];
+            driver->shadow.shown[LCD_DDRAM_INDEX(cell)] = data[i];
+        }
+    }
+    return 0;
+}
+
+int lcdMarqueeStart(lcdMarquee_t *marquee, lcdDriver_t *driver)
+{
+    assert(marquee);
+    assert(driver);
+    assert(driver->dimensions.height <= 2 && driver->layout.split == driver->dimensions.width);
+    assert(driver->layout.rowBase[0] == 0x00 && (driver->dimensions.height < 2 || driver->layout.rowBase[1] == 0x40));
+
+    memset(marquee, 0, sizeof(*marquee));
+    marquee->driver = driver;
+    return lcdHome(driver);
+}
+
+int lcdMarqueeSetText(lcdMarquee_t *marquee, uint8_t row, const char *text, size_t length)
+{
+    assert(marquee);
+    assert(text || length == 0);
+
+    lcdDriver_t *driver = marquee->driver;
+    assert(row < driver->dimensions.height);
+    assert(driver->direction);
+
+    uint8_t ring = lcdMarqueeRing(driver);
+    uint8_t line[LCD_DDRAM_SIZE];
+    for (uint8_t i = 0; i < ring; i++)
+        line[i] = (i < length) ? text[i] : ' ';
+
+    // Streaming needs a column out of view to write into.
+    if (length > ring)
+    {
+        assert(driver->dimensions.width < ring);
+        marquee->lines[row].text = text;
+        marquee->lines[row].length = length;
+        marquee->lines[row].next = ring;
+        marquee->lines[row].column = marquee->shift;
+    }
+    else
+    {
+        marquee->lines[row].text = NULL;
+    }
+
+    // The line goes round, the text starts at the column shown first.
+    uint8_t base = driver->layout.rowBase[row];
+    uint8_t shift = marquee->shift;
+    lcdLock(driver);
+    int result = (
+        lcdMarqueeWrite(driver, base + shift, line, ring - shift) ||
+        lcdMarqueeWrite(driver, base, line + ring - shift, shift)
+    ) ? -1 : 0;
+    lcdUnlock(driver);
+    return result;
+}
+
+int lcdMarqueeStep(lcdMarquee_t *marquee)
+{
+    assert(marquee);
+
+    lcdDriver_t *driver = marquee->driver;
+    uint8_t ring = lcdMarqueeRing(driver);
+
+    // Follow the display shift only once it happened, or the columns
+    // streamed into would no longer match the display.
+    lcdLock(driver);
+    int result = lcdCommand(driver, LCD_CMD_CURSOR(1, 0));
+    if (!result)
+        marquee->shift = (marquee->shift + 1) % ring;
+
+    // The columns shown first are out of view now, stream the characters one
+    // line length ahead into them. Usually one, more after a failed write.
+    for (uint8_t row = 0; row < 2 && !result; row++)
+    {
+        if (!marquee->lines[row].text)
+            continue;
+
+        while (!result && marquee->lines[row].column != marquee->shift)
+        {
+            uint8_t chr = marquee->lines[row].text[marquee->lines[row].next];
+            result = lcdMarqueeWrite(driver, driver->layout.rowBase[row] + marquee->lines[row].column, &chr, 1);
+            if (!result)
+            {
+                marquee->lines[row].next = (marquee->lines[row].next + 1) % marquee->lines[row].length;
+                marquee->lines[row].column = (marquee->lines[row].column + 1) % ring;
+            }
+        }
+    }
+    lcdUnlock(driver);
+    return result;
+}
+
+int lcdMarqueeStop(lcdMarquee_t *marquee)
+{
+    assert(marquee);
+
+    marquee->shift = 0;
+    marquee->lines[0].text = NULL;
+    marquee->lines[1].text = NULL;
+    return lcdHome(marquee->driver);
+}
@@ -0,0 +1,75 @@
+#include "lcd_multi.h"
+
+void lcdMultiInit(lcdMulti_t *multi, lcdDriver_t **drivers, uint8_t count)
+{
+    assert(multi);
+    assert(drivers && count);
+
+    multi->drivers = drivers;
+    multi->count = count;
+    multi->owner = -1;
+    multi->next = 0;
+    multi->enabled = false;
+    multi->free = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+        assert(drivers[i]->queue && drivers[i]->writeOnly);
+}
+
+int64_t lcdMultiPoll(lcdMulti_t *multi, uint64_t now)
+{
+    assert(multi);
+
+    for (;;)
+    {
+        // Nobody else may touch the lines during a strobe.
+        if (multi->owner >= 0)
+        {
+            lcdDriver_t *driver = multi->drivers[multi->owner];
+            int64_t due = lcdPollNext(driver, now);
+            if (due == LCD_POLL_IDLE)
+            {
+                multi->owner = -1;
+                continue;
+            }
+            if ((uint64_t)due > now)
+                return due;
+
+            lcdBusStep_t step;
+            if (lcdPollStep(driver, now, &step))
+                return -1;
+
+            // Enable fell, the data has to stay for the hold time only.
+            if (multi->enabled && !step.en)
+            {
+                multi->free = now + ((driver->busTiming.dataHold < step.delay) ? driver->busTiming.dataHold : step.delay);
+                multi->owner = -1;
+            }
+            multi->enabled = step.en;
+            continue;
+        }
+
+        if (now < multi->free)
+            return multi->free;
+
+        // Hand the lines to the first driver with a step due, in turn.
+        int64_t next = LCD_POLL_IDLE;
+        for (uint8_t i = 0; i < multi->count && multi->owner < 0; i++)
+        {
+            uint8_t index = (multi->next + i) % multi->count;
+            int64_t due = lcdPollNext(multi->drivers[index], now);
+            if ((uint64_t)due <= now)
+            {
+                multi->owner = index;
+                multi->next = (index + 1) % multi->count;
+            }
+            else if (due < next)
+            {
+                next = due;
+            }
+        }
+
+        if (multi->owner < 0)
+            return next;
+    }
+}
@@ -0,0 +1,82 @@
+#include "lcd_pcf8574.h"
+
+/**
+ * Expander transmit handler, one I2C write per transfer.
+ */
+static int lcdPcf8574Transmit(lcdExpander_t *expander, const uint8_t *data, size_t length)
+{
+    lcdPcf8574_t *backpack = (lcdPcf8574_t*)expander;
+    return backpack->write(backpack->bus, backpack->address, data, length);
+}
+
+void lcdPcf8574Init(lcdPcf8574_t *backpack, uint8_t address, uint32_t clock, uint16_t maxLength,
+    lcdI2CWriteHandler_t write, lcdI2CReadHandler_t read, void *bus)
+{
+    assert(backpack);
+    assert(clock);
+    assert(maxLength > 0 && maxLength <= LCD_EXPANDER_BUFFER);
+    assert(write);
+
+    memset(backpack, 0, sizeof(*backpack));
+    backpack->expander.pins = (lcdExpanderPins_t)LCD_PCF8574_PINS;
+    backpack->expander.backlight = true;
+    // 8 data bits and the acknowledge between two output updates.
+    backpack->expander.byteTime = (uint32_t)((9ull * 1000000000) / clock);
+    backpack->expander.leadBytes = 2;     // Address and first data byte.
+    backpack->expander.maxPadding = LCD_EXPANDER_MAX_PADDING;
+    backpack->expander.maxLength = maxLength;
+    backpack->expander.transmit = lcdPcf8574Transmit;
+    backpack->address = address;
+    backpack->write = write;
+    backpack->read = read;
+    backpack->bus = bus;
+}
+
+void lcdPcf8574Attach(lcdPcf8574_t *backpack, lcdDriver_t *driver)
+{
+    assert(backpack);
+    assert(driver);
+    assert(driver->fourBits);
+    assert(driver->writeOnly || backpack->read);
+
+    driver->userData = backpack;
+    driver->busIO = lcdPcf8574BusIO;
+    driver->batch = lcdExpanderBatch;
+}
+
+int lcdPcf8574BusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    lcdPcf8574_t *backpack = driver->userData;
+    assert(backpack);
+
+    // Quasi-bidirectional pins are inputs while they output high.
+    if (rw)
+        data = 0xF0;
+
+    uint8_t port = lcdExpanderPack(&backpack->expander, rw, rs, en, data);
+    if (backpack->write(backpack->bus, backpack->address, &port, 1) < 0)
+        return -1;
+    backpack->expander.port = port;
+
+    if (!rw || !en)
+        return 0;
+
+    assert(backpack->read);
+    if (backpack->read(backpack->bus, backpack->address, &port, 1) < 0)
+        return -1;
+    return lcdExpanderUnpack(&backpack->expander, port);
+}
+
+int lcdPcf8574Backlight(lcdDriver_t *driver, bool on)
+{
+    lcdPcf8574_t *backpack = driver->userData;
+    assert(backpack);
+
+    backpack->expander.backlight = on;
+    if (lcdPcf8574BusIO(driver, false, false, false, 0) < 0)
+    {
+        driver->error = EIO;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+#include "lcd_wave.h"
+
+size_t lcdWaveEncode(const lcdWave_t *wave, const lcdBusStep_t *steps, size_t count, lcdWaveSample_t *samples, size_t capacity)
+{
+    assert(wave);
+    assert(wave->samplePeriod);
+    assert(steps || count == 0);
+    assert(samples || capacity == 0);
+
+    size_t length = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t hold = lcdWaveLength(wave, &steps[i]);
+        if (hold > capacity - length)
+            return 0;
+
+        lcdWaveSample_t sample = lcdWavePack(wave, steps[i].rw, steps[i].rs, steps[i].en, steps[i].data);
+        while (hold--)
+            samples[length++] = sample;
+    }
+
+    return length;
+}
+
+/**
+ * Count samples handed to the peripheral.
+ * @param driver The driver structure.
+ * @param wave The encoder structure.
+ * @param length Number of samples.
+ */
+static void lcdWaveQueue(lcdDriver_t *driver, lcdWave_t *wave, size_t length)
+{
+    // With a clock, a frame queued after the last one has played starts now.
+    if (driver->now)
+    {
+        uint64_t now = driver->now(driver) * 1000;
+        if (wave->pending < now)
+            wave->pending = now;
+    }
+    wave->pending += (uint64_t)length * wave->samplePeriod;
+}
+
+/**
+ * Queue the encoded samples.
+ * @param driver The driver structure.
+ * @param wave The encoder structure.
+ * @return Non-zero if unsuccessful.
+ */
+static int lcdWaveFlush(lcdDriver_t *driver, lcdWave_t *wave)
+{
+    if (wave->length == 0)
+        return 0;
+
+    size_t length = wave->length;
+    wave->length = 0;
+    lcdWaveQueue(driver, wave, length);
+    return wave->submit(wave, wave->samples, length) < 0 ? -1 : 0;
+}
+
+/**
+ * Wait until the submitted samples have played, and a delay after them.
+ * @param driver The driver structure.
+ * @param wave The encoder structure.
+ * @param delay The delay after the samples, in microseconds.
+ * @return Non-zero if unsuccessful.
+ * @remarks The submit handler may return while the frame is still queued.
+ */
+static int lcdWaveWait(lcdDriver_t *driver, lcdWave_t *wave, uint32_t delay)
+{
+    uint64_t end = wave->pending + (uint64_t)delay * 1000;
+    uint64_t now = 0;
+
+    // With a clock, time spent since the frames were queued counts towards it.
+    if (driver->now)
+        now = driver->now(driver) * 1000;
+    else
+        wave->pending = 0;
+
+    if (end <= now)
+        return 0;
+    return lcdDelay(driver, (uint32_t)((end - now + 999) / 1000)) ? -1 : 0;
+}
+
+void lcdWaveInit(lcdWave_t *wave, uint32_t samplePeriod, lcdWaveSample_t *samples, size_t capacity, lcdWaveSubmitHandler_t submit)
+{
+    assert(wave);
+    assert(samplePeriod);
+    assert(samples && capacity);
+    assert(submit);
+
+    memset(wave, 0, sizeof(*wave));
+    wave->pins = (lcdWavePins_t)LCD_WAVE_PINS;
+    wave->samplePeriod = samplePeriod;
+    wave->maxHold = UINT32_MAX;
+    wave->submit = submit;
+    wave->samples = samples;
+    wave->capacity = capacity;
+}
+
+void lcdWaveAttach(lcdWave_t *wave, lcdDriver_t *driver)
+{
+    assert(wave);
+    assert(driver);
+    assert(driver->writeOnly);
+
+    driver->userData = wave;
+    driver->busIO = lcdWaveBusIO;
+    driver->batch = lcdWaveBatch;
+}
+
+int lcdWaveBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    lcdWave_t *wave = driver->userData;
+    assert(wave);
+
+    // Nothing is sampled back.
+    if (rw)
+        return -1;
+
+    // The pins are set once the frames before have played.
+    lcdWaveSample_t sample = lcdWavePack(wave, rw, rs, en, data);
+    if (lcdWaveFlush(driver, wave) || wave->submit(wave, &sample, 1) < 0)
+        return -1;
+    lcdWaveQueue(driver, wave, 1);
+    return lcdWaveWait(driver, wave, 0);
+}
+
+int lcdWaveBatch(lcdDriver_t *driver, const lcdBusStep_t *steps, size_t count, bool more)
+{
+    lcdWave_t *wave = driver->userData;
+    assert(wave);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        lcdWaveSample_t sample = lcdWavePack(wave, steps[i].rw, steps[i].rs, steps[i].en, steps[i].data);
+        size_t hold = lcdWaveLength(wave, &steps[i]);
+        uint32_t wait = 0;
+
+        // Too long to spend samples on, hold the state after the frame.
+        if (steps[i].delay > wave->maxHold)
+        {
+            hold = 1;
+            wait = steps[i].delay;
+        }
+
+        // Steps longer than the rest of the buffer continue in the next frame.
+        while (hold)
+        {
+            if (wave->length == wave->capacity && lcdWaveFlush(driver, wave))
+                return -1;
+
+            size_t length = wave->capacity - wave->length;
+            if (length > hold)
+                length = hold;
+            for (size_t j = 0; j < length; j++)
+                wave->samples[wave->length++] = sample;
+            hold -= length;
+        }
+
+        if (wait && (lcdWaveFlush(driver, wave) || lcdWaveWait(driver, wave, wait)))
+            return -1;
+    }
+
+    // Held samples go out with the following steps, or once the buffer is full.
+    if (more)
+        return 0;
+
+    // Later frames queue behind this one, so it plays on without a wait.
+    return lcdWaveFlush(driver, wave);
+}
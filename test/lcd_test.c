@@ -0,0 +1,1374 @@
+/**
+ * @file lcd_test.c Driver tests against the controller simulator.
+ */
+
+#define _XOPEN_SOURCE 700
+
+#include "lcd_sim.h"
+#include "lcd_pcf8574.h"
+#include "lcd_74hc595.h"
+#include "lcd_wave.h"
+#include "lcd_async.h"
+#include "lcd_dual.h"
+#include "lcd_marquee.h"
+#include "lcd_glyph.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#define CHECK_ROW(sim, row, expected) do { \
+        char text[LCD_DDRAM_SIZE + 1]; \
+        lcdSimGetRow((sim), (row), text); \
+        if (strcmp(text, (expected)) != 0) { \
+            printf("%s:%d: %s: row %d is \"%s\", expected \"%s\"\n", __FILE__, __LINE__, __func__, (row), text, (expected)); \
+            failures++; \
+        } \
+    } while (0)
+
+#define CHECK_PREFIX(sim, row, expected) do { \
+        char text[LCD_DDRAM_SIZE + 1]; \
+        lcdSimGetRow((sim), (row), text); \
+        CHECK(strncmp(text, (expected), strlen(expected)) == 0); \
+    } while (0)
+
+static void testViolation(lcdSim_t *sim, const char *message)
+{
+    printf("violation at %llu ns: %s\n", (unsigned long long)sim->now, message);
+}
+
+/**
+ * Set up a simulator and an initialized driver.
+ */
+static void setup(lcdSim_t *sim, lcdDriver_t *driver, uint8_t width, uint8_t height, bool fourBits, bool writeOnly)
+{
+    lcdSimInit(sim, width, height, fourBits);
+    sim->violation = testViolation;
+
+    memset(driver, 0, sizeof(*driver));
+    driver->dimensions.width = width;
+    driver->dimensions.height = height;
+    driver->fourBits = fourBits;
+    driver->writeOnly = writeOnly;
+    lcdSimAttach(sim, driver);
+    lcdLoadDefaultTiming(driver);
+
+    CHECK(lcdInit(driver) == 0);
+    CHECK(lcdSetDisplay(driver, true, false, false) == 0);
+}
+
+static void testPutString(void)
+{
+    for (int mode = 0; mode < 4; mode++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 20, 4, mode & 1, mode & 2);
+
+        CHECK(sim.eightBit == !(mode & 1));
+        CHECK(sim.twoLines);
+
+        CHECK(lcdSetCursor(&lcd, 15, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "0123456789") == 0);
+        CHECK(lcdPutChar(&lcd, 'A') == 0);
+        CHECK(lcdSetCursor(&lcd, 18, 3) == 0);
+        CHECK(lcdPutZString(&lcd, "xyz") == 0);
+
+        CHECK_ROW(&sim, 0, "z              01234");
+        CHECK_ROW(&sim, 1, "56789A              ");
+        CHECK_ROW(&sim, 2, "                    ");
+        CHECK_ROW(&sim, 3, "                  xy");
+        CHECK(sim.violations == 0);
+    }
+}
+
+static void testReverse(void)
+{
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 2, true, true);
+
+    CHECK(lcdDirection(&lcd, false) == 0);
+    CHECK(lcdSetCursor(&lcd, 2, 1) == 0);
+    CHECK(lcdPutZString(&lcd, "abcd") == 0);
+
+    CHECK_ROW(&sim, 0, "               d");
+    CHECK_ROW(&sim, 1, "cba             ");
+    CHECK(sim.violations == 0);
+}
+
+static void testAddressTracking(void)
+{
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 2, true, true);
+
+    // One address set for the string, none for the characters following it.
+    uint32_t commands = sim.counters.commands;
+    CHECK(lcdSetCursor(&lcd, 4, 1) == 0);
+    CHECK(lcdPutZString(&lcd, "ab") == 0);
+    CHECK(lcdPutChar(&lcd, 'c') == 0);
+    CHECK(sim.counters.commands - commands == 1);
+    CHECK_ROW(&sim, 1, "    abc         ");
+
+    // Wrapping to the next row needs a new address.
+    commands = sim.counters.commands;
+    CHECK(lcdSetCursor(&lcd, 15, 0) == 0);
+    CHECK(lcdPutZString(&lcd, "yz") == 0);
+    CHECK(sim.counters.commands - commands == 2);
+    CHECK_ROW(&sim, 0, "               y");
+    CHECK_ROW(&sim, 1, "z   abc         ");
+
+    // Cursor moves step the address counter, display shifts do not.
+    CHECK(lcdSetCursor(&lcd, 0, 0) == 0);
+    CHECK(lcdCommand(&lcd, LCD_CMD_CURSOR(0, 1)) == 0);
+    CHECK(lcdPutChar(&lcd, 'X') == 0);
+    CHECK(lcdSetCursor(&lcd, 6, 0) == 0);
+    CHECK(lcdCommand(&lcd, LCD_CMD_CURSOR(0, 0)) == 0);
+    CHECK(lcdCommand(&lcd, LCD_CMD_CURSOR(1, 1)) == 0);
+    CHECK(lcdCommand(&lcd, LCD_CMD_CURSOR(1, 0)) == 0);
+    CHECK(lcdPutChar(&lcd, 'Y') == 0);
+    CHECK_ROW(&sim, 0, "X     Y        y");
+    CHECK(sim.violations == 0);
+}
+
+static void testGlyph(void)
+{
+    static const uint8_t bits[8] = { 0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00 };
+
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 2, true, false);
+
+    CHECK(lcdSetCursor(&lcd, 0, 0) == 0);
+    CHECK(lcdPutZString(&lcd, "a") == 0);
+    CHECK(lcdStoreGlyph(&lcd, 3, bits) == 0);
+    CHECK(memcmp(&sim.cgram[3 * 8], bits, sizeof(bits)) == 0);
+
+    // The address counter was in character RAM, the next character must not go there.
+    CHECK(lcdPutChar(&lcd, 3) == 0);
+    CHECK(lcdSimPeek(&sim, 0x01) == 3);
+    CHECK(sim.violations == 0);
+}
+
+static void testFlush(void)
+{
+    for (int mode = 0; mode < 2; mode++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 20, 4, true, mode);
+        lcd.buffered = true;
+
+        CHECK(lcdClear(&lcd) == 0);
+        CHECK(lcdSetCursor(&lcd, 0, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "Temp: 21C") == 0);
+        CHECK(lcdSetCursor(&lcd, 0, 2) == 0);
+        CHECK(lcdPutZString(&lcd, "Fan: on") == 0);
+
+        // Nothing is sent before the flush.
+        CHECK_ROW(&sim, 0, "                    ");
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK_ROW(&sim, 0, "Temp: 21C           ");
+        CHECK_ROW(&sim, 2, "Fan: on             ");
+
+        // Redrawing the same screen only sends the changed digit.
+        uint32_t writes = sim.counters.writes;
+        CHECK(lcdClear(&lcd) == 0);
+        CHECK(lcdSetCursor(&lcd, 0, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "Temp: 22C") == 0);
+        CHECK(lcdSetCursor(&lcd, 0, 2) == 0);
+        CHECK(lcdPutZString(&lcd, "Fan: on") == 0);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK(sim.counters.writes - writes == 1);
+        CHECK_ROW(&sim, 0, "Temp: 22C           ");
+
+        // Nearby changes are merged into one run.
+        uint32_t commands = sim.counters.commands;
+        CHECK(lcdSetCursor(&lcd, 6, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "1") == 0);
+        CHECK(lcdSetCursor(&lcd, 8, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "F") == 0);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK(sim.counters.commands - commands == 1);
+        CHECK_ROW(&sim, 0, "Temp: 12F           ");
+
+        // Moving the cursor stays off the bus, like setting it.
+        commands = sim.counters.commands;
+        CHECK(lcdSetCursor(&lcd, 6, 0) == 0);
+        CHECK(lcdNext(&lcd) == 0);
+        CHECK(lcdPutZString(&lcd, "3") == 0);
+        CHECK(sim.counters.commands == commands);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK_ROW(&sim, 0, "Temp: 13F           ");
+
+        // Direct writes keep the shadow in step, so buffering can be toggled.
+        lcd.buffered = false;
+        CHECK(lcdSetCursor(&lcd, 0, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "Direct") == 0);
+        lcd.buffered = true;
+        CHECK(lcdSetCursor(&lcd, 0, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "Dir") == 0);
+        writes = sim.counters.writes;
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK(sim.counters.writes == writes);
+        CHECK_ROW(&sim, 1, "Direct              ");
+
+        lcd.buffered = false;
+        CHECK(lcdClear(&lcd) == 0);
+        lcd.buffered = true;
+        CHECK(lcdSetCursor(&lcd, 0, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "Temp: 13F") == 0);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK_ROW(&sim, 0, "Temp: 13F           ");
+        CHECK_ROW(&sim, 1, "                    ");
+        CHECK(sim.violations == 0);
+    }
+
+    // Bytes inside a run are not polled for, with a slow set-up and a quick
+    // address set a one byte gap is still cheaper to rewrite.
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 20, 4, true, false);
+    lcd.buffered = true;
+    lcd.busTiming.addressSetup = 10;
+    lcd.busTiming.dataWrite = 40;
+    lcd.busTiming.execute[LCD_CMD_CLASS(LCD_CMD_DADDR(0))] = 10;
+
+    uint32_t commands = sim.counters.commands;
+    CHECK(lcdSetCursor(&lcd, 2, 1) == 0);
+    CHECK(lcdPutZString(&lcd, "a b") == 0);
+    CHECK(lcdFlush(&lcd) == 0);
+    CHECK(sim.counters.commands - commands == 1);
+    CHECK_ROW(&sim, 1, "  a b               ");
+    CHECK(sim.violations == 0);
+}
+
+static void testRead(void)
+{
+    for (int fourBits = 0; fourBits < 2; fourBits++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 16, 2, fourBits, false);
+
+        CHECK(lcdSetCursor(&lcd, 3, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "hello") == 0);
+        CHECK(lcdReadStatus(&lcd) == 0x48);
+
+        uint8_t data[5];
+        CHECK(lcdCommand(&lcd, LCD_CMD_DADDR(0x43)) == 0);
+        CHECK(lcdReadBuffer(&lcd, data, sizeof(data)) == 0);
+        CHECK(memcmp(data, "hello", 5) == 0);
+
+        // Reload the shadow, writing what is already shown sends nothing.
+        lcd.buffered = true;
+        memset(lcd.shadow.ram, 0, sizeof(lcd.shadow.ram));
+        CHECK(lcdShadowRead(&lcd) == 0);
+        uint32_t writes = sim.counters.writes;
+        CHECK(lcdSetCursor(&lcd, 3, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "help!") == 0);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK(sim.counters.writes - writes == 2);
+        CHECK_ROW(&sim, 1, "   help!        ");
+        CHECK(sim.violations == 0);
+    }
+}
+
+static int testBatch(lcdDriver_t *driver, const lcdBusStep_t *steps, size_t count, bool more)
+{
+    // Nothing is held back, every step is executed right away.
+    (void)more;
+    lcdSim_t *sim = driver->userData;
+    for (size_t i = 0; i < count; i++)
+    {
+        lcdSimPins(sim, steps[i].rw, steps[i].rs, steps[i].en, steps[i].data);
+        lcdSimAdvance(sim, (uint64_t)steps[i].delay * 1000);
+    }
+    return 0;
+}
+
+static void testBatched(void)
+{
+    for (int mode = 0; mode < 4; mode++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 20, 4, mode & 1, mode & 2);
+        lcd.batch = testBatch;
+
+        CHECK(lcdSetCursor(&lcd, 15, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "0123456789") == 0);
+        CHECK(lcdPutChar(&lcd, 'A') == 0);
+        CHECK(lcdSetCursor(&lcd, 18, 3) == 0);
+        CHECK(lcdPutZString(&lcd, "xyz") == 0);
+
+        CHECK_ROW(&sim, 0, "z              01234");
+        CHECK_ROW(&sim, 1, "56789A              ");
+        CHECK_ROW(&sim, 3, "                  xy");
+        CHECK(sim.violations == 0);
+    }
+}
+
+static void testStats(void)
+{
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 2, true, false);
+
+    lcdStats_t stats;
+    uint64_t now = sim.now;
+    lcdResetStats(&lcd);
+    CHECK(lcdSetCursor(&lcd, 0, 1) == 0);
+    CHECK(lcdPutZString(&lcd, "abc") == 0);
+    CHECK(lcdClear(&lcd) == 0);
+    lcdGetStats(&lcd, &stats);
+
+    CHECK(stats.commands == 2);
+    CHECK(stats.writes == 3);
+    CHECK(stats.busyPolls >= 3);
+    CHECK(stats.errors == 0);
+    CHECK(stats.delayTotal * 1000 == sim.now - now);
+    CHECK(stats.maxLatency >= sim.timing.executeLong / 1000);
+
+    lcdResetStats(&lcd);
+    lcdGetStats(&lcd, &stats);
+    CHECK(stats.commands == 0 && stats.delayTotal == 0 && stats.maxLatency == 0);
+}
+
+/**
+ * Mock PCF8574 on an I2C bus, driving the simulator with the common backpack wiring.
+ */
+typedef struct {
+    lcdSim_t sim;
+    uint32_t byteTime;              /** Nanoseconds per byte on the wire. */
+    uint8_t port;                   /** Output latch. */
+    uint32_t transactions;          /** I2C transactions. */
+    uint32_t bytes;                 /** Bytes on the wire, address bytes included. */
+} mockI2C_t;
+
+static int mockI2CWrite(void *bus, uint8_t address, const uint8_t *data, size_t length)
+{
+    mockI2C_t *mock = bus;
+    CHECK(address == LCD_PCF8574_ADDRESS);
+    mock->transactions++;
+    mock->bytes += length + 1;
+
+    // The outputs change at the acknowledge of each data byte.
+    lcdSimAdvance(&mock->sim, mock->byteTime);
+    for (size_t i = 0; i < length; i++)
+    {
+        lcdSimAdvance(&mock->sim, mock->byteTime);
+        mock->port = data[i];
+        lcdSimPins(&mock->sim, data[i] & 0x02, data[i] & 0x01, data[i] & 0x04, data[i] & 0xF0);
+    }
+    return 0;
+}
+
+static int mockI2CRead(void *bus, uint8_t address, uint8_t *data, size_t length)
+{
+    mockI2C_t *mock = bus;
+    CHECK(address == LCD_PCF8574_ADDRESS);
+    mock->transactions++;
+    mock->bytes += length + 1;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        lcdSimAdvance(&mock->sim, 2 * mock->byteTime);
+        uint8_t port = mock->port;
+        int value = lcdSimPins(&mock->sim, port & 0x02, port & 0x01, port & 0x04, port & 0xF0);
+        data[i] = (port & 0x0F) | (value & 0xF0);
+    }
+    return 0;
+}
+
+static int mockI2CDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    lcdPcf8574_t *backpack = driver->userData;
+    mockI2C_t *mock = backpack->bus;
+    lcdSimAdvance(&mock->sim, (uint64_t)delay * 1000);
+    return 0;
+}
+
+static void testPcf8574(void)
+{
+    for (int writeOnly = 0; writeOnly < 2; writeOnly++)
+    {
+        mockI2C_t mock;
+        memset(&mock, 0, sizeof(mock));
+        lcdSimInit(&mock.sim, 20, 4, true);
+        mock.sim.violation = testViolation;
+
+        lcdPcf8574_t backpack;
+        lcdPcf8574Init(&backpack, LCD_PCF8574_ADDRESS, 100000, LCD_EXPANDER_BUFFER, mockI2CWrite, writeOnly ? NULL : mockI2CRead, &mock);
+        mock.byteTime = backpack.expander.byteTime;
+
+        lcdDriver_t lcd;
+        memset(&lcd, 0, sizeof(lcd));
+        lcd.dimensions.width = 20;
+        lcd.dimensions.height = 4;
+        lcd.fourBits = true;
+        lcd.writeOnly = writeOnly;
+        lcd.delay = mockI2CDelay;
+        lcdLoadDefaultTiming(&lcd);
+        lcdPcf8574Attach(&backpack, &lcd);
+
+        CHECK(lcdInit(&lcd) == 0);
+        CHECK(lcdSetDisplay(&lcd, true, false, false) == 0);
+        CHECK(mock.port & 0x08);
+
+        // The address set, then the 20 characters of a row in one go.
+        mock.transactions = 0;
+        CHECK(lcdSetCursor(&lcd, 0, 2) == 0);
+        CHECK(lcdPutZString(&lcd, "Temperature:  21.5 C") == 0);
+        CHECK_ROW(&mock.sim, 2, "Temperature:  21.5 C");
+        if (writeOnly)
+            CHECK(mock.transactions == 2);
+
+        CHECK(lcdClear(&lcd) == 0);
+        CHECK(lcdSetCursor(&lcd, 3, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "hello") == 0);
+        CHECK_ROW(&mock.sim, 1, "   hello            ");
+        CHECK_ROW(&mock.sim, 2, "                    ");
+        if (!writeOnly)
+            CHECK(lcdReadStatus(&lcd) == 0x48);
+
+        // A whole buffered screen goes out in a single transaction.
+        static const char *const screen[4] = {
+            "Temperature:  21.5 C", "Humidity:     40.0 %", "Pressure:   1013 hPa", "Uptime:     12:34:56",
+        };
+        lcd.buffered = true;
+        for (uint8_t row = 0; row < 4; row++)
+        {
+            CHECK(lcdSetCursor(&lcd, 0, row) == 0);
+            CHECK(lcdPutZString(&lcd, screen[row]) == 0);
+        }
+        mock.transactions = 0;
+        CHECK(lcdFlush(&lcd) == 0);
+        for (uint8_t row = 0; row < 4; row++)
+            CHECK_ROW(&mock.sim, row, screen[row]);
+        if (writeOnly)
+            CHECK(mock.transactions == 1);
+        lcd.buffered = false;
+
+        CHECK(lcdPcf8574Backlight(&lcd, false) == 0);
+        CHECK(!(mock.port & 0x08));
+        CHECK(mock.sim.violations == 0);
+    }
+}
+
+/**
+ * Mock SPI bus with a 74HC595 latched after every byte, decoding the buffers into the simulator.
+ */
+typedef struct {
+    lcdSim_t sim;
+    uint32_t byteTime;              /** Nanoseconds per byte on the wire. */
+    uint8_t port;                   /** Output latch. */
+    uint32_t transfers;             /** SPI transfers. */
+    uint32_t bytes;                 /** Bytes over all transfers. */
+} mockSpi_t;
+
+static int mockSpiWrite(void *bus, const uint8_t *data, size_t length)
+{
+    mockSpi_t *mock = bus;
+    mock->transfers++;
+    mock->bytes += length;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        lcdSimAdvance(&mock->sim, mock->byteTime);
+        mock->port = data[i];
+        CHECK(!(data[i] & 0x01));
+        lcdSimPins(&mock->sim, false, data[i] & 0x02, data[i] & 0x04, (data[i] << 1) & 0xF0);
+    }
+    return 0;
+}
+
+static int mockSpiDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    lcd74hc595_t *shifter = driver->userData;
+    mockSpi_t *mock = shifter->bus;
+    lcdSimAdvance(&mock->sim, (uint64_t)delay * 1000);
+    return 0;
+}
+
+static void test74hc595(void)
+{
+    mockSpi_t mock;
+    memset(&mock, 0, sizeof(mock));
+    lcdSimInit(&mock.sim, 20, 4, true);
+    mock.sim.violation = testViolation;
+
+    lcd74hc595_t shifter;
+    lcd74hc595Init(&shifter, 1000000, LCD_EXPANDER_BUFFER, mockSpiWrite, &mock);
+    mock.byteTime = shifter.expander.byteTime;
+
+    lcdDriver_t lcd;
+    memset(&lcd, 0, sizeof(lcd));
+    lcd.dimensions.width = 20;
+    lcd.dimensions.height = 4;
+    lcd.fourBits = true;
+    lcd.writeOnly = true;
+    lcd.delay = mockSpiDelay;
+    lcdLoadDefaultTiming(&lcd);
+    lcd74hc595Attach(&shifter, &lcd);
+
+    CHECK(lcdInit(&lcd) == 0);
+    CHECK(lcdSetDisplay(&lcd, true, false, false) == 0);
+    CHECK(mock.port & 0x80);
+
+    // The address set, then the whole row in one transfer.
+    mock.transfers = 0;
+    CHECK(lcdSetCursor(&lcd, 0, 3) == 0);
+    CHECK(lcdPutZString(&lcd, "Uptime:     12:34:56") == 0);
+    CHECK_ROW(&mock.sim, 3, "Uptime:     12:34:56");
+    CHECK(mock.transfers == 2);
+
+    // A buffered flush is one transfer, or one per maxLength bytes.
+    static const char *const screen[2] = { "Temperature:  21.5 C", "Humidity:     40.0 %" };
+    CHECK(lcdClear(&lcd) == 0);
+    for (int limited = 0; limited < 2; limited++)
+    {
+        shifter.expander.maxLength = limited ? 32 : LCD_EXPANDER_BUFFER;
+        lcd.buffered = true;
+        for (uint8_t row = 0; row < 2; row++)
+        {
+            CHECK(lcdSetCursor(&lcd, 0, 2 * limited + row) == 0);
+            CHECK(lcdPutZString(&lcd, screen[row]) == 0);
+        }
+        mock.transfers = 0;
+        mock.bytes = 0;
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK(mock.transfers == (limited ? (mock.bytes + 31) / 32 : 1));
+        lcd.buffered = false;
+    }
+    for (uint8_t row = 0; row < 4; row++)
+        CHECK_ROW(&mock.sim, row, screen[row % 2]);
+    shifter.expander.maxLength = LCD_EXPANDER_BUFFER;
+
+    CHECK(lcdClear(&lcd) == 0);
+    CHECK(lcdSetCursor(&lcd, 18, 0) == 0);
+    CHECK(lcdPutZString(&lcd, "wrap") == 0);
+    CHECK_ROW(&mock.sim, 0, "                  wr");
+    CHECK_ROW(&mock.sim, 1, "ap                  ");
+    CHECK(mock.sim.violations == 0);
+}
+
+/**
+ * Mock parallel DMA peripheral clocking frames into the simulator.
+ */
+typedef struct {
+    lcdSim_t sim;
+    uint32_t frames;                /** Submitted frames. */
+} mockWave_t;
+
+static int mockWaveSubmit(lcdWave_t *wave, const lcdWaveSample_t *samples, size_t length)
+{
+    mockWave_t *mock = wave->userData;
+    mock->frames++;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        lcdSimPins(&mock->sim, samples[i] & 0x200, samples[i] & 0x100, samples[i] & 0x400, samples[i] & 0xFF);
+        lcdSimAdvance(&mock->sim, wave->samplePeriod);
+    }
+    return 0;
+}
+
+static int mockWaveDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    lcdWave_t *wave = driver->userData;
+    mockWave_t *mock = wave->userData;
+    lcdSimAdvance(&mock->sim, (uint64_t)delay * 1000);
+    return 0;
+}
+
+static size_t queuedSamples;
+static uint64_t queuedDelay;
+
+static int queueWaveSubmit(lcdWave_t *wave, const lcdWaveSample_t *samples, size_t length)
+{
+    (void)wave;
+    (void)samples;
+    queuedSamples += length;
+    return 0;
+}
+
+static uint64_t queuedNow;
+
+static int queueWaveDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    (void)driver;
+    queuedDelay += delay;
+    queuedNow += delay;
+    return 0;
+}
+
+static uint64_t queueWaveNow(lcdDriver_t *driver)
+{
+    (void)driver;
+    return queuedNow;
+}
+
+static void testWave(void)
+{
+    static lcdWaveSample_t buffer[2048];
+
+    // Every step takes enough samples to cover its delay, at least one.
+    lcdWave_t wave;
+    lcdWaveInit(&wave, 1000, buffer, 16, mockWaveSubmit);
+    const lcdBusStep_t steps[3] = {
+        { .rs = 1, .en = 0, .data = 0x41, .delay = 10 },
+        { .rs = 1, .en = 1, .data = 0x41, .delay = 0 },
+        { .rs = 1, .en = 0, .data = 0x41, .delay = 3 },
+    };
+    CHECK(lcdWaveEncode(&wave, steps, 3, buffer, 16) == 14);
+    CHECK(buffer[0] == 0x141 && buffer[9] == 0x141 && buffer[10] == 0x541 && buffer[11] == 0x141);
+    CHECK(lcdWaveEncode(&wave, steps, 3, buffer, 13) == 0);
+
+    // A submit that only queues the frame, batches return right away and a
+    // direct access waits until the frames have played.
+    lcdDriver_t queued;
+    memset(&queued, 0, sizeof(queued));
+    queued.writeOnly = true;
+    queued.delay = queueWaveDelay;
+    lcdWaveInit(&wave, 1000, buffer, 2048, queueWaveSubmit);
+    lcdWaveAttach(&wave, &queued);
+    CHECK(lcdWaveBatch(&queued, steps, 3, false) == 0);
+    CHECK(lcdWaveBatch(&queued, steps, 3, false) == 0);
+    CHECK(queuedSamples == 28 && queuedDelay == 0);
+    CHECK(lcdWaveBusIO(&queued, false, false, false, 0) == 0);
+    CHECK(queuedSamples == 29 && queuedDelay >= 29);
+
+    // With a clock, only what is left of the frames is waited for.
+    queued.now = queueWaveNow;
+    queuedNow = 1000;
+    queuedDelay = 0;
+    CHECK(lcdWaveBatch(&queued, steps, 3, false) == 0);
+    queuedNow += 10;
+    CHECK(lcdWaveBusIO(&queued, false, false, false, 0) == 0);
+    CHECK(queuedDelay == 5);
+
+    // A delay longer than maxHold is waited for after its frame.
+    wave.maxHold = 5;
+    queuedNow += 100;
+    queuedDelay = 0;
+    CHECK(lcdWaveBatch(&queued, steps, 3, false) == 0);
+    CHECK(queuedDelay == 11);
+
+    for (int mode = 0; mode < 4; mode++)
+    {
+        mockWave_t mock;
+        memset(&mock, 0, sizeof(mock));
+        lcdSimInit(&mock.sim, 20, 4, mode & 1);
+        mock.sim.violation = testViolation;
+
+        lcdWaveInit(&wave, 1000, buffer, (mode & 2) ? 64 : 2048, mockWaveSubmit);
+        wave.userData = &mock;
+        if (mode & 2)
+            wave.maxHold = 100;
+
+        lcdDriver_t lcd;
+        memset(&lcd, 0, sizeof(lcd));
+        lcd.dimensions.width = 20;
+        lcd.dimensions.height = 4;
+        lcd.fourBits = mode & 1;
+        lcd.writeOnly = true;
+        lcd.delay = mockWaveDelay;
+        lcdLoadDefaultTiming(&lcd);
+        lcdWaveAttach(&wave, &lcd);
+
+        CHECK(lcdInit(&lcd) == 0);
+        CHECK(lcdSetDisplay(&lcd, true, false, false) == 0);
+
+        // With a large buffer a command and each batch of the string is one frame.
+        mock.frames = 0;
+        CHECK(lcdSetCursor(&lcd, 0, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "Humidity:     40.0 %") == 0);
+        CHECK_ROW(&mock.sim, 1, "Humidity:     40.0 %");
+        if (!(mode & 2))
+            CHECK(mock.frames == 2);  // The address set, then the whole string.
+
+        CHECK(lcdClear(&lcd) == 0);
+        CHECK(lcdPutZString(&lcd, "ok") == 0);
+        CHECK_ROW(&mock.sim, 0, "ok                  ");
+        CHECK_ROW(&mock.sim, 1, "                    ");
+        CHECK(mock.sim.violations == 0);
+    }
+}
+
+static uint64_t simClock(lcdDriver_t *driver)
+{
+    lcdSim_t *sim = driver->userData;
+    return sim->now / 1000;
+}
+
+/**
+ * Run the queue of a non-blocking driver to the end, advancing the simulator clock.
+ */
+static void drainQueue(lcdSim_t *sim, lcdDriver_t *driver)
+{
+    for (;;)
+    {
+        uint64_t now = sim->now / 1000;
+        int64_t next = lcdPoll(driver, now);
+        CHECK(next >= 0);
+        if (next < 0 || next == LCD_POLL_IDLE)
+            break;
+        CHECK((uint64_t)next > now);
+        lcdSimAdvance(sim, (uint64_t)next * 1000 - sim->now);
+    }
+}
+
+static void testPoll(void)
+{
+    lcdBusStep_t queue[512];
+
+    for (int size = 0; size < 2; size++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 20, 4, true, true);
+        lcd.queue = queue;
+        lcd.queueSize = size ? 512 : 16;
+
+        // Nothing reaches the bus and no time passes until polled.
+        uint32_t strobes = sim.counters.strobes;
+        uint64_t now = sim.now;
+        CHECK(lcdSetCursor(&lcd, 0, 1) == 0);
+        CHECK(lcdPutZString(&lcd, "Pressure:   1013 hPa") == 0);
+        CHECK(lcdHome(&lcd) == 0);
+        if (size)
+        {
+            CHECK(sim.counters.strobes == strobes);
+            CHECK(sim.now == now);
+        }
+
+        drainQueue(&sim, &lcd);
+        CHECK_ROW(&sim, 1, "Pressure:   1013 hPa");
+        CHECK(lcdPoll(&lcd, sim.now / 1000) == LCD_POLL_IDLE);
+
+        // Blocking calls and polling mix.
+        CHECK(lcdClear(&lcd) == 0);
+        CHECK(lcdPutZString(&lcd, "abc") == 0);
+        CHECK(lcdSync(&lcd) == 0);
+        CHECK_ROW(&sim, 0, "abc                 ");
+        CHECK(lcdPutChar(&lcd, 'd') == 0);
+        drainQueue(&sim, &lcd);
+        CHECK_ROW(&sim, 0, "abcd                ");
+
+        // With a clock, a blocking wait only covers what is left of the last delay.
+        lcd.now = simClock;
+        CHECK(lcdClear(&lcd) == 0);
+        drainQueue(&sim, &lcd);
+        lcdSimAdvance(&sim, 1000000);
+        now = sim.now;
+        CHECK(lcdSync(&lcd) == 0);
+        CHECK(sim.now - now < 1000000);  // Not the whole 1.52 ms of the clear.
+        CHECK(lcdPutZString(&lcd, "ok") == 0);
+        drainQueue(&sim, &lcd);
+        CHECK_ROW(&sim, 0, "ok                  ");
+        CHECK(sim.violations == 0);
+    }
+}
+
+static void testClock(void)
+{
+    for (int writeOnly = 0; writeOnly < 2; writeOnly++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 20, 4, true, writeOnly);
+        lcd.now = simClock;
+
+        // Without time passing, the first access after the clear waits for it.
+        CHECK(lcdClear(&lcd) == 0);
+        uint64_t total = lcd.stats.delayTotal;
+        uint64_t slept = lcd.stats.delaySlept;
+        CHECK(lcdPutZString(&lcd, "ok") == 0);
+        if (writeOnly)
+            CHECK(lcd.stats.delaySlept - slept > lcd.stats.delayTotal - total);
+
+        // Work between calls covers it.
+        CHECK(lcdClear(&lcd) == 0);
+        lcdSimAdvance(&sim, 2000000);
+        total = lcd.stats.delayTotal;
+        slept = lcd.stats.delaySlept;
+        CHECK(lcdPutZString(&lcd, "ok") == 0);
+        CHECK(lcd.stats.delaySlept - slept <= lcd.stats.delayTotal - total);
+
+        // The latency is the time a call took, not the delay it requested.
+        lcdResetStats(&lcd);
+        uint64_t before = sim.now;
+        CHECK(lcdClear(&lcd) == 0);
+        CHECK(lcd.stats.maxLatency <= (sim.now - before) / 1000 + 1);
+        if (writeOnly)
+            CHECK(lcd.stats.maxLatency < lcd.stats.delayTotal);
+        lcdSimAdvance(&sim, 2000000);
+        CHECK(lcdPutZString(&lcd, "ok") == 0);
+
+        CHECK_ROW(&sim, 0, "ok                  ");
+        CHECK(sim.violations == 0);
+    }
+}
+
+/**
+ * Producer thread for the display task test, rewrites one row.
+ */
+typedef struct {
+    lcdAsync_t *async;
+    int8_t row;
+    uint32_t full;                  /** Pushes refused because the ring was full. */
+} producer_t;
+
+static void *producerThread(void *arg)
+{
+    producer_t *producer = arg;
+    char text[32];
+
+    for (int i = 0; i <= 200; i++)
+    {
+        snprintf(text, sizeof(text), "row %d count %-8d", producer->row, i);
+        while (lcdAsyncPutString(producer->async, 0, producer->row, text, 20))
+        {
+            producer->full++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void testAsync(void)
+{
+    static lcdAsyncSlot_t slots[64];
+
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 20, 4, true, true);
+
+    lcdAsync_t async;
+    CHECK(lcdAsyncStart(&async, &lcd, slots, 64) == 0);
+    CHECK(lcdAsyncCommand(&async, LCD_CMD_CLEAR()) == 0);
+
+    // Strings from several threads are never mixed up.
+    producer_t producers[4];
+    pthread_t threads[4];
+    for (int i = 0; i < 4; i++)
+    {
+        producers[i].async = &async;
+        producers[i].row = i;
+        producers[i].full = 0;
+        CHECK(pthread_create(&threads[i], NULL, producerThread, &producers[i]) == 0);
+    }
+    for (int i = 0; i < 4; i++)
+        pthread_join(threads[i], NULL);
+
+    // A string longer than the ring does not fit.
+    char text[80];
+    memset(text, 'x', sizeof(text));
+    CHECK(lcdAsyncPutString(&async, 0, 0, text, sizeof(text)) != 0);
+
+    CHECK(lcdAsyncStop(&async) == 0);
+    CHECK(atomic_load(&async.errors) == 0);
+    CHECK_ROW(&sim, 0, "row 0 count 200     ");
+    CHECK_ROW(&sim, 1, "row 1 count 200     ");
+    CHECK_ROW(&sim, 2, "row 2 count 200     ");
+    CHECK_ROW(&sim, 3, "row 3 count 200     ");
+    CHECK(sim.violations == 0);
+}
+
+static pthread_mutex_t testMutex;
+
+static void testLockHandler(lcdDriver_t *driver)
+{
+    (void)driver;
+    pthread_mutex_lock(&testMutex);
+}
+
+static void testUnlockHandler(lcdDriver_t *driver)
+{
+    (void)driver;
+    pthread_mutex_unlock(&testMutex);
+}
+
+/**
+ * Writer thread for the lock test, rewrites one row.
+ */
+typedef struct {
+    lcdDriver_t *driver;
+    uint8_t row;
+} writer_t;
+
+static void *writerThread(void *arg)
+{
+    writer_t *writer = arg;
+    char text[32];
+
+    for (int i = 0; i <= 100; i++)
+    {
+        snprintf(text, sizeof(text), "task %d pass %-9d", writer->row, i);
+
+        // Positioning and writing stay together, the string locks again inside.
+        lcdLock(writer->driver);
+        CHECK(lcdSetCursor(writer->driver, 0, writer->row) == 0);
+        CHECK(lcdPutString(writer->driver, text, 20) == 0);
+        lcdUnlock(writer->driver);
+
+        CHECK(lcdPutChar(writer->driver, '.') == 0);
+    }
+    return NULL;
+}
+
+static void testLock(void)
+{
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&testMutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 20, 4, true, false);
+    lcd.lock = testLockHandler;
+    lcd.unlock = testUnlockHandler;
+
+    writer_t writers[2] = { { &lcd, 0 }, { &lcd, 2 } };
+    pthread_t threads[2];
+    for (int i = 0; i < 2; i++)
+        CHECK(pthread_create(&threads[i], NULL, writerThread, &writers[i]) == 0);
+    for (int i = 0; i < 2; i++)
+        pthread_join(threads[i], NULL);
+
+    // The dots follow a whole string, on the row below it, never inside one.
+    char text[LCD_DDRAM_SIZE + 1];
+    lcdSimGetRow(&sim, 0, text);
+    CHECK(strncmp(text, "task 0 pass 100", 15) == 0);
+    lcdSimGetRow(&sim, 2, text);
+    CHECK(strncmp(text, "task 2 pass 100", 15) == 0);
+    CHECK(sim.violations == 0);
+
+    pthread_mutex_destroy(&testMutex);
+}
+
+/**
+ * Displays sharing RS, R/W and D4-D7, each with its own enable line. Every
+ * simulator sees every change of the shared lines.
+ */
+typedef struct {
+    lcdSim_t sims[3];
+    uint8_t count;
+} sharedBus_t;
+
+typedef struct {
+    sharedBus_t *bus;
+    uint8_t index;
+} sharedPort_t;
+
+static int sharedBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    sharedPort_t *port = driver->userData;
+    for (uint8_t i = 0; i < port->bus->count; i++)
+    {
+        lcdSim_t *sim = &port->bus->sims[i];
+        lcdSimPins(sim, rw, rs, (i == port->index) ? en : false, data);
+    }
+    return 0;
+}
+
+static int sharedDelay(lcdDriver_t *driver, uint32_t delay)
+{
+    sharedPort_t *port = driver->userData;
+    for (uint8_t i = 0; i < port->bus->count; i++)
+        lcdSimAdvance(&port->bus->sims[i], (uint64_t)delay * 1000);
+    return 0;
+}
+
+static uint64_t sharedClock(lcdDriver_t *driver)
+{
+    sharedPort_t *port = driver->userData;
+    return port->bus->sims[0].now / 1000;
+}
+
+/**
+ * Write a line on each display through the scheduler.
+ * @return Time it took in microseconds.
+ */
+static uint64_t multiRun(uint8_t count)
+{
+    static const char *const lines[3] = { "first display 12", "second display 3", "third display 45" };
+    static lcdBusStep_t queues[3][256];
+
+    sharedBus_t bus;
+    sharedPort_t ports[3];
+    lcdDriver_t lcds[3];
+    lcdDriver_t *drivers[3];
+    bus.count = count;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        lcdSimInit(&bus.sims[i], 16, 2, true);
+        bus.sims[i].violation = testViolation;
+        ports[i].bus = &bus;
+        ports[i].index = i;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        lcdDriver_t *lcd = &lcds[i];
+        memset(lcd, 0, sizeof(*lcd));
+        lcd->dimensions.width = 16;
+        lcd->dimensions.height = 2;
+        lcd->fourBits = true;
+        lcd->writeOnly = true;
+        lcd->userData = &ports[i];
+        lcd->busIO = sharedBusIO;
+        lcd->delay = sharedDelay;
+        lcdLoadDefaultTiming(lcd);
+        lcd->busTiming.addressSetup = 1;
+        lcd->busTiming.enableHold = 1;
+        lcd->busTiming.dataHold = 1;
+        CHECK(lcdInit(lcd) == 0);
+        CHECK(lcdSetDisplay(lcd, true, false, false) == 0);
+        lcd->queue = queues[i];
+        lcd->queueSize = 256;
+        drivers[i] = lcd;
+    }
+
+    lcdMulti_t multi;
+    lcdMultiInit(&multi, drivers, count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        CHECK(lcdSetCursor(&lcds[i], 0, 1) == 0);
+        CHECK(lcdPutZString(&lcds[i], lines[i]) == 0);
+    }
+
+    uint64_t start = bus.sims[0].now / 1000;
+    for (;;)
+    {
+        uint64_t now = bus.sims[0].now / 1000;
+        int64_t next = lcdMultiPoll(&multi, now);
+        CHECK(next >= 0);
+        if (next < 0 || next == LCD_POLL_IDLE)
+            break;
+        for (uint8_t i = 0; i < count; i++)
+            lcdSimAdvance(&bus.sims[i], (uint64_t)next * 1000 - bus.sims[i].now);
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        CHECK_ROW(&bus.sims[i], 1, lines[i]);
+        CHECK(bus.sims[i].violations == 0);
+    }
+    return bus.sims[0].now / 1000 - start;
+}
+
+static void testMulti(void)
+{
+    // Three displays take little longer than one.
+    uint64_t single = multiRun(1);
+    uint64_t triple = multiRun(3);
+    CHECK(triple * 2 < single * 3);
+}
+
+static void testDual(void)
+{
+    static lcdDual_t dual;
+    sharedBus_t bus;
+    sharedPort_t ports[2];
+    bus.count = 2;
+
+    memset(&dual, 0, sizeof(dual));
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        lcdSimInit(&bus.sims[i], 40, 2, true);
+        bus.sims[i].violation = testViolation;
+        ports[i].bus = &bus;
+        ports[i].index = i;
+
+        lcdDriver_t *half = &dual.halves[i];
+        half->fourBits = true;
+        half->writeOnly = true;
+        half->userData = &ports[i];
+        half->busIO = sharedBusIO;
+        half->delay = sharedDelay;
+        lcdLoadDefaultTiming(half);
+    }
+
+    CHECK(lcdDualInit(&dual, 40) == 0);
+    CHECK(lcdDualSetDisplay(&dual, true, false, false) == 0);
+
+    // Rows go to their controller, and text runs on from row 1 into row 2.
+    CHECK(lcdDualClear(&dual) == 0);
+    CHECK(lcdDualSetCursor(&dual, 0, 0) == 0);
+    CHECK(lcdDualPutZString(&dual, "row zero") == 0);
+    CHECK(lcdDualSetCursor(&dual, 36, 1) == 0);
+    CHECK(lcdDualPutZString(&dual, "wrapping") == 0);
+    CHECK(lcdDualSetCursor(&dual, 0, 3) == 0);
+    CHECK(lcdDualPutZString(&dual, "row three") == 0);
+    CHECK(lcdDualFlush(&dual) == 0);
+
+    CHECK_PREFIX(&bus.sims[0], 0, "row zero");
+    CHECK_PREFIX(&bus.sims[0], 1, "                                    wrap");
+    CHECK_PREFIX(&bus.sims[1], 0, "ping");
+    CHECK_PREFIX(&bus.sims[1], 1, "row three");
+
+    // A row in each half takes little longer than a row in one of them.
+    uint64_t start = bus.sims[0].now;
+    CHECK(lcdDualSetCursor(&dual, 0, 0) == 0);
+    CHECK(lcdDualPutZString(&dual, "top half changes only") == 0);
+    CHECK(lcdDualFlush(&dual) == 0);
+    uint64_t single = bus.sims[0].now - start;
+
+    start = bus.sims[0].now;
+    CHECK(lcdDualSetCursor(&dual, 0, 1) == 0);
+    CHECK(lcdDualPutZString(&dual, "both halves change at") == 0);
+    CHECK(lcdDualSetCursor(&dual, 0, 2) == 0);
+    CHECK(lcdDualPutZString(&dual, "once, so they overlap") == 0);
+    CHECK(lcdDualFlush(&dual) == 0);
+    uint64_t both = bus.sims[0].now - start;
+
+    CHECK(both * 2 < single * 3);
+    CHECK_PREFIX(&bus.sims[0], 1, "both halves change at               wrap");
+    CHECK_PREFIX(&bus.sims[1], 0, "once, so they overlap");
+
+    // With a clock on the first half, the flush runs on it.
+    dual.halves[0].now = sharedClock;
+    CHECK(lcdDualSetCursor(&dual, 0, 3) == 0);
+    CHECK(lcdDualPutZString(&dual, "on the clock") == 0);
+    CHECK(lcdDualFlush(&dual) == 0);
+    CHECK_PREFIX(&bus.sims[1], 1, "on the clock");
+    CHECK(bus.sims[0].violations == 0);
+    CHECK(bus.sims[1].violations == 0);
+}
+
+static void testGeometry(void)
+{
+    // 16x1 modules addressed as 8x2, written directly and through the shadow.
+    for (int buffered = 0; buffered < 2; buffered++)
+    {
+        lcdSim_t sim;
+        lcdDriver_t lcd;
+        setup(&sim, &lcd, 16, 1, true, true);
+        sim.split = 8;
+        lcd.geometry = LCD_GEOMETRY_SPLIT;
+        lcd.buffered = buffered;
+        CHECK(lcdInit(&lcd) == 0);
+        CHECK(lcdSetDisplay(&lcd, true, false, false) == 0);
+        CHECK(sim.twoLines);
+        CHECK(lcd.layout.split == 8);
+
+        CHECK(lcdSetCursor(&lcd, 4, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "split row") == 0);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK_ROW(&sim, 0, "    split row   ");
+
+        CHECK(lcdDirection(&lcd, false) == 0);
+        CHECK(lcdSetCursor(&lcd, 10, 0) == 0);
+        CHECK(lcdPutZString(&lcd, "<-back") == 0);
+        CHECK(lcdFlush(&lcd) == 0);
+        CHECK_ROW(&sim, 0, "    skcab-<ow   ");
+        CHECK(sim.violations == 0);
+    }
+
+    // 16x4 modules using the rows of a 20x4 layout.
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 4, true, true);
+    sim.rowBase[2] = 0x14;
+    sim.rowBase[3] = 0x54;
+    lcd.geometry = LCD_GEOMETRY_WIDE;
+    CHECK(lcdInit(&lcd) == 0);
+    CHECK(lcdSetDisplay(&lcd, true, false, false) == 0);
+    CHECK(lcdSetCursor(&lcd, 12, 1) == 0);
+    CHECK(lcdPutZString(&lcd, "wraps to row two") == 0);
+    CHECK_ROW(&sim, 1, "            wrap");
+    CHECK_ROW(&sim, 2, "s to row two    ");
+
+    // Custom layouts are left alone.
+    lcd.geometry = LCD_GEOMETRY_CUSTOM;
+    lcd.layout.rowBase[1] = 0x48;
+    CHECK(lcdInit(&lcd) == 0);
+    CHECK(LCD_DECODE_POSITION(&lcd, 3, 1) == 0x4B);
+    CHECK(sim.violations == 0);
+}
+
+static const char marqueeTicker[] = "A ticker longer than a display RAM line, streamed in column by column. ";
+
+/** Bus calls left before the next one fails, negative for none. */
+static int marqueeFailIn = -1;
+static uint32_t marqueeCalls;
+
+static int marqueeBusIO(lcdDriver_t *driver, bool rw, bool rs, bool en, uint8_t data)
+{
+    marqueeCalls++;
+    if (marqueeFailIn >= 0 && marqueeFailIn-- == 0)
+        return -1;
+    return lcdSimBusIO(driver, rw, rs, en, data);
+}
+
+/**
+ * Check what the marquee shows after a number of steps.
+ */
+static void checkMarquee(lcdSim_t *sim, size_t step)
+{
+    size_t length = strlen(marqueeTicker);
+    char expected[17];
+    for (size_t x = 0; x < 16; x++)
+        expected[x] = marqueeTicker[(step + x) % length];
+    expected[16] = 0;
+    CHECK_ROW(sim, 0, expected);
+
+    for (size_t x = 0; x < 16; x++)
+    {
+        size_t column = (step + x) % LCD_DDRAM_LINE;
+        expected[x] = (column < 5) ? "short"[column] : ' ';
+    }
+    CHECK_ROW(sim, 1, expected);
+}
+
+static void testMarquee(void)
+{
+    size_t length = strlen(marqueeTicker);
+
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 2, true, true);
+    lcd.buffered = true;
+    lcd.busIO = marqueeBusIO;
+
+    lcdMarquee_t marquee;
+    CHECK(lcdMarqueeStart(&marquee, &lcd) == 0);
+    CHECK(lcdMarqueeSetText(&marquee, 0, marqueeTicker, length) == 0);
+    CHECK(lcdMarqueeSetText(&marquee, 1, "short", 5) == 0);
+
+    // Twice round the text, checking what is shown after every step.
+    size_t step;
+    for (step = 1; step <= 2 * length; step++)
+    {
+        lcdStats_t before = lcd.stats;
+        CHECK(lcdMarqueeStep(&marquee) == 0);
+        CHECK(lcd.stats.commands - before.commands <= 2);
+        CHECK(lcd.stats.writes - before.writes == 1);
+        checkMarquee(&sim, step);
+    }
+
+    // A shift failing before any edge leaves the display where it was.
+    marqueeCalls = 0;
+    CHECK(lcdCommand(&lcd, LCD_CMD_DISPLAY(1, 0, 0)) == 0);
+    uint32_t commandCalls = marqueeCalls;
+    marqueeFailIn = 0;
+    CHECK(lcdMarqueeStep(&marquee) != 0);
+    checkMarquee(&sim, step - 1);
+
+    // A failed write is caught up with on the next step.
+    marqueeFailIn = commandCalls;
+    CHECK(lcdMarqueeStep(&marquee) != 0);
+    checkMarquee(&sim, step);
+    for (step++; step <= 3 * length; step++)
+    {
+        CHECK(lcdMarqueeStep(&marquee) == 0);
+        checkMarquee(&sim, step);
+    }
+
+    // The shadow holds what the marquee wrote, a flush has nothing to send.
+    lcdStats_t before = lcd.stats;
+    CHECK(lcdFlush(&lcd) == 0);
+    CHECK(lcd.stats.writes == before.writes);
+
+    CHECK(lcdMarqueeStop(&marquee) == 0);
+    CHECK(sim.displayShift == 0);
+    CHECK(sim.violations == 0);
+}
+
+static void testGlyphCache(void)
+{
+    lcdSim_t sim;
+    lcdDriver_t lcd;
+    setup(&sim, &lcd, 16, 2, true, true);
+    lcd.buffered = true;
+
+    lcdGlyphCache_t cache;
+    lcdGlyphInit(&cache, &lcd);
+
+    // Fill all slots, each glyph shown once on the top row.
+    uint8_t icons[10][8];
+    for (int id = 0; id < 10; id++)
+        for (int row = 0; row < 8; row++)
+            icons[id][row] = (uint8_t)(id * 8 + row);
+
+    CHECK(lcdSetCursor(&lcd, 0, 0) == 0);
+    for (int id = 0; id < 8; id++)
+        CHECK(lcdGlyphPut(&cache, id, icons[id]) == 0);
+    CHECK(lcdFlush(&lcd) == 0);
+    CHECK(memcmp(sim.cgram, icons, 64) == 0);
+
+    // Known glyphs are not uploaded again.
+    lcdStats_t before = lcd.stats;
+    CHECK(lcdGlyphGet(&cache, 3, icons[3]) == 8 + 3);
+    CHECK(lcd.stats.writes == before.writes);
+
+    // Every slot is on the display, nothing can be evicted.
+    CHECK(lcdGlyphGet(&cache, 8, icons[8]) < 0);
+    CHECK(lcd.error == ENOSPC);
+
+    // Free two cells, the least recently used of their slots goes first.
+    CHECK(lcdSetCursor(&lcd, 5, 0) == 0);
+    CHECK(lcdPutZString(&lcd, " ") == 0);
+    CHECK(lcdSetCursor(&lcd, 1, 0) == 0);
+    CHECK(lcdPutZString(&lcd, " ") == 0);
+    CHECK(lcdGlyphGet(&cache, 8, icons[8]) < 0);    // Still shown until flushed.
+    CHECK(lcdFlush(&lcd) == 0);
+    CHECK(lcdGlyphGet(&cache, 8, icons[8]) == 8 + 1);
+    CHECK(lcdGlyphGet(&cache, 9, icons[9]) == 8 + 5);
+    CHECK(memcmp(&sim.cgram[8], icons[8], 8) == 0);
+    CHECK(memcmp(&sim.cgram[40], icons[9], 8) == 0);
+
+    // Changed bits are uploaded again into the same slot.
+    icons[9][0] = 0x1F;
+    before = lcd.stats;
+    CHECK(lcdGlyphGet(&cache, 9, icons[9]) == 8 + 5);
+    CHECK(lcd.stats.writes - before.writes == 8);
+    CHECK(sim.cgram[40] == 0x1F);
+    CHECK(sim.violations == 0);
+}
+
+int main(void)
+{
+    testPutString();
+    testReverse();
+    testAddressTracking();
+    testGlyph();
+    testFlush();
+    testRead();
+    testBatched();
+    testStats();
+    testPcf8574();
+    test74hc595();
+    testWave();
+    testPoll();
+    testClock();
+    testAsync();
+    testLock();
+    testMulti();
+    testDual();
+    testGeometry();
+    testMarquee();
+    testGlyphCache();
+
+    if (failures)
+        printf("%d checks failed\n", failures);
+    else
+        printf("all checks passed\n");
+    return failures ? 1 : 0;
+}